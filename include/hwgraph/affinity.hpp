@@ -0,0 +1,106 @@
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "graph.hpp"
+
+/* Placing threads and memory near a device.
+
+   Packages and host bridges found by hwloc carry the CPUs and NUMA nodes
+   they are local to (Vertex::locality()). Any other vertex is as close as
+   the nearest vertex with a locality, by hops.
+*/
+
+namespace hwgraph {
+
+/* the locality of v, or of the vertex with a locality fewest hops from v.
+   Empty if no vertex reachable from v has one
+*/
+inline Locality closest_locality(Graph &g, const Vertex_t &v) {
+  const Locality *l = v->locality();
+  if (l && !l->empty()) {
+    return *l;
+  }
+  auto has_locality = [](const Vertex_t &u) {
+    const Locality *ul = u->locality();
+    return ul && !ul->empty();
+  };
+  Path path;
+  const Vertex_t closest = g.shortest_path(v, has_locality, path);
+  Locality ret;
+  if (closest) {
+    ret = *closest->locality();
+  } else {
+    std::memset(&ret, 0, sizeof(ret));
+  }
+  return ret;
+}
+
+/* the lowest NUMA node closest to v, or -1 if none is known
+ */
+inline int closest_numa_node(Graph &g, const Vertex_t &v) {
+  return closest_locality(g, v).first_node();
+}
+
+/* the Core vertices whose hardware threads are all among the CPUs closest to
+   v, by logical index. Empty if the graph has no cores or v has no locality
+*/
+inline std::vector<Vertex_t> closest_cores(Graph &g, const Vertex_t &v) {
+  const Locality l = closest_locality(g, v);
+  std::vector<Vertex_t> ret;
+  for (const Vertex_t &c : g.vertices()) {
+    if (c->type_ == Vertex::Type::Core &&
+        !c->data_.core.locality.empty() &&
+        c->data_.core.locality.cpus_within(l)) {
+      ret.push_back(c);
+    }
+  }
+  std::sort(ret.begin(), ret.end(), [](const Vertex_t &a, const Vertex_t &b) {
+    return a->data_.core.idx < b->data_.core.idx;
+  });
+  return ret;
+}
+
+/* Bind the calling thread to the CPUs in l, and its future memory
+   allocations to the NUMA nodes in l. Either half is skipped if l has no
+   CPUs or no nodes. false if the OS refused a binding
+*/
+inline bool bind_thread(const Locality &l) {
+  bool ok = true;
+
+  cpu_set_t cpus;
+  CPU_ZERO(&cpus);
+  bool anyCpu = false;
+  for (unsigned i = 0; i < Locality::MAX_CPUS && i < CPU_SETSIZE; ++i) {
+    if (l.has_cpu(i)) {
+      CPU_SET(i, &cpus);
+      anyCpu = true;
+    }
+  }
+  if (anyCpu) {
+    ok &= 0 == pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+  }
+
+  if (l.first_node() >= 0) {
+    // set_mempolicy(2) with MPOL_BIND, without a libnuma dependency
+    const int MPOL_BIND_ = 2;
+    ok &= 0 == syscall(SYS_set_mempolicy, MPOL_BIND_, l.nodes,
+                       (unsigned long)(Locality::MAX_NODES + 1));
+  }
+  return ok;
+}
+
+/* bind the calling thread and its memory near v. See bind_thread
+ */
+inline bool bind_near(Graph &g, const Vertex_t &v) {
+  return bind_thread(closest_locality(g, v));
+}
+
+} // namespace hwgraph
@@ -0,0 +1,198 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "graph.hpp"
+#include "mat2d.hpp"
+
+/* Communication patterns for collectives over a set of GPUs, after NCCL's
+   search in
+   https://github.com/NVIDIA/nccl/blob/master/src/graph/search.cc
+   and trees in
+   https://github.com/NVIDIA/nccl/blob/master/src/graph/trees.cc
+
+   The bandwidth between two GPUs is the bottleneck bandwidth of the widest
+   path between them (Graph::all_pairs), so NVLink and PCIe edges both count.
+   Links shared by several pairs are not split between them.
+*/
+
+namespace hwgraph {
+
+/* rings of up to this many GPUs are searched exhaustively
+ */
+constexpr size_t RING_EXACT_MAX = 12;
+
+struct Ring {
+  std::vector<Vertex_t> order; // each sends to the next, and the last to the
+                               // first
+  double bandwidth; // narrowest step of the ring, inf for fewer than 2 GPUs
+};
+
+/* the narrowest step of the ring through order, by positions in bw
+ */
+inline double ring_bandwidth(const Mat2D<double> &bw,
+                             const std::vector<int64_t> &order) {
+  if (order.size() < 2) {
+    return std::numeric_limits<double>::infinity();
+  }
+  double ret = std::numeric_limits<double>::infinity();
+  for (size_t i = 0; i < order.size(); ++i) {
+    const int64_t next = order[(i + 1) % order.size()];
+    ret = std::min(ret, bw(order[i], next));
+  }
+  return ret;
+}
+
+/* Ring order over 0..bw.rows()-1 with the widest narrowest step.
+   Greedy widest-neighbor order improved by 2-opt, then branch-and-bound if
+   there are at most RING_EXACT_MAX vertices
+*/
+inline std::vector<int64_t> best_ring_order(const Mat2D<double> &bw) {
+  const int64_t n = bw.rows();
+  std::vector<int64_t> best;
+  if (n == 0) {
+    return best;
+  }
+
+  // greedy: always step to the widest unvisited neighbor
+  std::vector<char> used(n, 0);
+  best.push_back(0);
+  used[0] = 1;
+  for (int64_t i = 1; i < n; ++i) {
+    int64_t next = -1;
+    for (int64_t v = 0; v < n; ++v) {
+      if (!used[v] &&
+          (next < 0 || bw(best.back(), v) > bw(best.back(), next))) {
+        next = v;
+      }
+    }
+    used[next] = 1;
+    best.push_back(next);
+  }
+
+  // 2-opt: reverse best[i+1..j] if that widens the two steps it replaces
+  for (bool improved = true; improved;) {
+    improved = false;
+    for (int64_t i = 0; i + 2 < n; ++i) {
+      for (int64_t j = i + 2; j < n; ++j) {
+        const int64_t a = best[i], b = best[i + 1];
+        const int64_t c = best[j], d = best[(j + 1) % n];
+        if (a == d) {
+          continue;
+        }
+        if (std::min(bw(a, c), bw(b, d)) > std::min(bw(a, b), bw(c, d))) {
+          std::reverse(best.begin() + i + 1, best.begin() + j + 1);
+          improved = true;
+        }
+      }
+    }
+  }
+  if (n > int64_t(RING_EXACT_MAX)) {
+    return best;
+  }
+
+  // branch-and-bound from vertex 0, pruning any prefix no wider than best
+  double bestBw = ring_bandwidth(bw, best);
+  std::vector<int64_t> order = {0};
+  std::vector<double> width = {std::numeric_limits<double>::infinity()};
+  std::fill(used.begin(), used.end(), 0);
+  used[0] = 1;
+  std::vector<int64_t> cursor = {0}; // next vertex to try after order[i]
+  while (!order.empty()) {
+    if (int64_t(order.size()) == n) {
+      const double w = std::min(width.back(), bw(order.back(), 0));
+      if (w > bestBw) {
+        bestBw = w;
+        best = order;
+      }
+    }
+
+    int64_t &v = cursor.back();
+    while (v < n && (used[v] || std::min(width.back(), bw(order.back(), v)) <=
+                                    bestBw)) {
+      ++v;
+    }
+    if (v == n) {
+      used[order.back()] = 0;
+      order.pop_back();
+      width.pop_back();
+      cursor.pop_back();
+      continue;
+    }
+    const double w = std::min(width.back(), bw(order.back(), v));
+    used[v] = 1;
+    order.push_back(v);
+    width.push_back(w);
+    ++v;
+    cursor.push_back(0);
+  }
+  return best;
+}
+
+/* the ring through gpus with the widest narrowest step
+ */
+inline Ring best_ring(Graph &g, const std::vector<Vertex_t> &gpus) {
+  const Mat2D<double> bw = g.all_pairs().bandwidth_among(gpus);
+  const std::vector<int64_t> order = best_ring_order(bw);
+  Ring ret;
+  for (int64_t i : order) {
+    ret.order.push_back(gpus[i]);
+  }
+  ret.bandwidth = ring_bandwidth(bw, order);
+  return ret;
+}
+
+/* parent of rank in NCCL's binary tree over n ranks, or -1 for the root.
+   Rank 0 is the root, with one child
+*/
+inline int64_t btree_parent(int64_t n, int64_t rank) {
+  if (rank == 0) {
+    return -1;
+  }
+  const int64_t bit = rank & -rank;
+  const int64_t up = (rank ^ bit) | (bit << 1);
+  return up < n ? up : rank ^ bit;
+}
+
+/* Two binary trees over the same ranks, so that most ranks are a leaf in one
+   of them. The second is the first mirrored for an even number of ranks, and
+   shifted by one for an odd number
+*/
+struct DoubleTree {
+  std::vector<Vertex_t> ranks;
+  std::vector<int64_t> parent[2]; // parent rank in each tree, -1 for a root
+  double bandwidth; // narrowest tree edge in either tree, inf if none
+};
+
+/* NCCL's double binary tree over ranks. ranks should be in an order where
+   neighbors are close, such as a Ring's
+*/
+inline DoubleTree double_binary_tree(Graph &g,
+                                     const std::vector<Vertex_t> &ranks) {
+  const Mat2D<double> bw = g.all_pairs().bandwidth_among(ranks);
+  const int64_t n = ranks.size();
+  DoubleTree ret;
+  ret.ranks = ranks;
+  ret.bandwidth = std::numeric_limits<double>::infinity();
+  for (int64_t r = 0; r < n; ++r) {
+    ret.parent[0].push_back(btree_parent(n, r));
+    if (n % 2) {
+      const int64_t p = btree_parent(n, (r - 1 + n) % n);
+      ret.parent[1].push_back(p < 0 ? -1 : (p + 1) % n);
+    } else {
+      const int64_t p = btree_parent(n, n - 1 - r);
+      ret.parent[1].push_back(p < 0 ? -1 : n - 1 - p);
+    }
+    for (int t = 0; t < 2; ++t) {
+      if (ret.parent[t][r] >= 0) {
+        ret.bandwidth = std::min(ret.bandwidth, bw(r, ret.parent[t][r]));
+      }
+    }
+  }
+  return ret;
+}
+
+} // namespace hwgraph
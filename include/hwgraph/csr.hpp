@@ -0,0 +1,389 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <limits>
+#include <map>
+#include <queue>
+#include <vector>
+
+#include "graph.hpp"
+
+namespace hwgraph {
+
+/* a list of edge ids in a CsrGraph, from source to destination
+ */
+typedef std::vector<uint32_t> EdgePath;
+
+/* A frozen, compressed-sparse-row copy of a Graph.
+
+   Vertices and edges get dense ids in [0, num_vertices()) and
+   [0, num_edges()). The edges incident to vertex i are adj_[offsets_[i]] to
+   adj_[offsets_[i+1]], and per-edge attributes live in contiguous arrays.
+   Changes to the source Graph after freeze() are not reflected.
+*/
+class CsrGraph {
+public:
+  enum : uint32_t { NONE = 0xffffffff }; // no such vertex or edge
+
+  struct Adj {
+    uint32_t vertex; // the neighbor
+    uint32_t edge;   // the edge to the neighbor
+  };
+
+  CsrGraph() : version_(0) {}
+
+  explicit CsrGraph(const Graph &g) : version_(g.version()) {
+    vertices_.assign(g.vertices().begin(), g.vertices().end());
+    for (uint32_t i = 0; i < vertices_.size(); ++i) {
+      vertexIds_[vertices_[i]] = i;
+      vertexTypes_.push_back(vertices_[i]->type_);
+    }
+
+    edges_.assign(g.edges().begin(), g.edges().end());
+    std::vector<uint32_t> degree(vertices_.size(), 0);
+    for (uint32_t i = 0; i < edges_.size(); ++i) {
+      const Edge_t &e = edges_[i];
+      edgeIds_[e] = i;
+      edgeU_.push_back(vertexIds_.at(e->u_));
+      edgeV_.push_back(vertexIds_.at(e->v_));
+      edgeTypes_.push_back(e->type_);
+      bandwidth_.push_back(e->has_bandwidth() ? double(e->bandwidth()) : -1);
+      ++degree[edgeU_[i]];
+      ++degree[edgeV_[i]];
+    }
+
+    offsets_.resize(vertices_.size() + 1, 0);
+    for (uint32_t i = 0; i < vertices_.size(); ++i) {
+      offsets_[i + 1] = offsets_[i] + degree[i];
+    }
+
+    // edges_ is in the same order as each vertex's edge set, so each
+    // vertex's adjacency is too
+    adj_.resize(offsets_.back());
+    std::vector<uint32_t> pos(offsets_.begin(), offsets_.end() - 1);
+    for (uint32_t i = 0; i < edges_.size(); ++i) {
+      Adj a;
+      a.edge = i;
+      a.vertex = edgeV_[i];
+      adj_[pos[edgeU_[i]]++] = a;
+      a.vertex = edgeU_[i];
+      adj_[pos[edgeV_[i]]++] = a;
+    }
+  }
+
+  /* Graph::version() this was frozen from
+   */
+  uint64_t version() const noexcept { return version_; }
+
+  uint32_t num_vertices() const noexcept { return vertices_.size(); }
+  uint32_t num_edges() const noexcept { return edges_.size(); }
+
+  const Vertex_t &vertex(uint32_t i) const { return vertices_[i]; }
+  const Edge_t &edge(uint32_t i) const { return edges_[i]; }
+
+  /* dense id of a vertex or edge, or NONE if it is not in the graph
+   */
+  uint32_t id(const Vertex_t &v) const {
+    auto it = vertexIds_.find(v);
+    return it == vertexIds_.end() ? NONE : it->second;
+  }
+  uint32_t id(const Edge_t &e) const {
+    auto it = edgeIds_.find(e);
+    return it == edgeIds_.end() ? NONE : it->second;
+  }
+
+  Vertex::Type vertex_type(uint32_t i) const { return vertexTypes_[i]; }
+  Edge::Type edge_type(uint32_t i) const { return edgeTypes_[i]; }
+  double bandwidth(uint32_t e) const { return bandwidth_[e]; }
+  uint32_t edge_u(uint32_t e) const { return edgeU_[e]; }
+  uint32_t edge_v(uint32_t e) const { return edgeV_[e]; }
+
+  /* neighbors of vertex i are [adj_begin(i), adj_end(i))
+   */
+  const Adj *adj_begin(uint32_t i) const { return adj_.data() + offsets_[i]; }
+  const Adj *adj_end(uint32_t i) const { return adj_.data() + offsets_[i + 1]; }
+
+  uint32_t other_vertex(uint32_t e, uint32_t v) const {
+    return edgeU_[e] == v ? edgeV_[e] : edgeU_[e];
+  }
+
+  Path to_path(const EdgePath &p) const {
+    Path ret;
+    ret.reserve(p.size());
+    for (uint32_t e : p) {
+      ret.push_back(edges_[e]);
+    }
+    return ret;
+  }
+
+  double path_bandwidth(const EdgePath &p) const {
+    if (p.empty()) {
+      return -1;
+    }
+    double ret = std::numeric_limits<double>::infinity();
+    for (uint32_t e : p) {
+      ret = std::min(ret, bandwidth_[e]);
+    }
+    return ret;
+  }
+
+  /* same search as Graph::shortest_path
+   */
+  template <typename UnaryPredicate>
+  std::pair<EdgePath, uint32_t> shortest_path(uint32_t src,
+                                              UnaryPredicate p) const {
+    if (src == NONE) {
+      return std::make_pair(EdgePath(), NONE);
+    }
+
+    std::vector<uint32_t> parent(vertices_.size(), NONE);
+    std::vector<uint32_t> worklist(vertices_.size());
+    size_t head = 0, tail = 0;
+    worklist[tail++] = src;
+
+    while (head < tail) {
+      const uint32_t u = worklist[head++];
+      for (const Adj *a = adj_begin(u); a != adj_end(u); ++a) {
+        if (a->vertex == src || parent[a->vertex] != NONE) {
+          continue;
+        }
+        parent[a->vertex] = a->edge;
+        if (p(a->vertex)) {
+          EdgePath ret;
+          for (uint32_t v = a->vertex; v != src;
+               v = other_vertex(ret.back(), v)) {
+            ret.push_back(parent[v]);
+          }
+          std::reverse(ret.begin(), ret.end());
+          return std::make_pair(ret, a->vertex);
+        }
+        worklist[tail++] = a->vertex;
+      }
+    }
+    return std::make_pair(EdgePath(), NONE);
+  }
+
+  /* same search as Graph::paths
+   */
+  std::vector<EdgePath> paths(uint32_t src, uint32_t dst) const {
+    std::vector<EdgePath> ret;
+    for_each_path(src, dst, [&](const EdgePath &p) { ret.push_back(p); });
+    return ret;
+  }
+
+  // return the path from src to dst that has the minimum cost.
+  // if no path is found, return an empty path
+  EdgePath min_path(uint32_t src, uint32_t dst,
+                    std::function<float(const EdgePath &)> cost) const {
+    return best_path(src, dst, cost, std::less<float>());
+  }
+
+  // return the path from src to dst that has the max cost.
+  // if no path is found, return an empty path
+  EdgePath max_path(uint32_t src, uint32_t dst,
+                    std::function<float(const EdgePath &)> cost) const {
+    return best_path(src, dst, cost, std::greater<float>());
+  }
+
+  /* same search as Graph::widest_tree, over vertex ids.
+     width and parent are resized to num_vertices()
+  */
+  void widest_tree(uint32_t src, std::vector<double> &width,
+                   std::vector<uint32_t> &parent, uint32_t dst = NONE) const {
+    typedef std::pair<double, uint32_t> Entry;
+    width.assign(vertices_.size(), -std::numeric_limits<double>::infinity());
+    parent.assign(vertices_.size(), NONE);
+    std::vector<char> done(vertices_.size(), 0);
+    std::priority_queue<Entry> worklist;
+
+    width[src] = std::numeric_limits<double>::infinity();
+    worklist.push(std::make_pair(width[src], src));
+
+    while (!worklist.empty()) {
+      const uint32_t u = worklist.top().second;
+      worklist.pop();
+      if (done[u]) {
+        continue; // stale entry
+      }
+      done[u] = 1;
+      if (u == dst) {
+        break;
+      }
+
+      for (const Adj *a = adj_begin(u); a != adj_end(u); ++a) {
+        if (done[a->vertex]) {
+          continue;
+        }
+        const double w = std::min(width[u], bandwidth_[a->edge]);
+        if (parent[a->vertex] == NONE || w > width[a->vertex]) {
+          width[a->vertex] = w;
+          parent[a->vertex] = a->edge;
+          worklist.push(std::make_pair(w, a->vertex));
+        }
+      }
+    }
+  }
+
+  /* same answer as Graph::widest_path
+   */
+  EdgePath widest_path(uint32_t src, uint32_t dst) const {
+    if (src == NONE || dst == NONE || src == dst) {
+      return EdgePath();
+    }
+    std::vector<double> width;
+    std::vector<uint32_t> parent;
+    widest_tree(src, width, parent, dst);
+    if (parent[dst] == NONE) {
+      return EdgePath();
+    }
+
+    EdgePath ret;
+    for (uint32_t v = dst; v != src; v = other_vertex(ret.back(), v)) {
+      ret.push_back(parent[v]);
+    }
+    std::reverse(ret.begin(), ret.end());
+    return ret;
+  }
+
+  /* same result as Graph::all_pairs, with rows and columns in vertex id order
+   */
+  PairMatrix all_pairs() const {
+    const int64_t n = vertices_.size();
+    PairMatrix ret;
+    ret.version = version_;
+    ret.vertices = vertices_;
+    for (int64_t i = 0; i < n; ++i) {
+      ret.index[vertices_[i]] = i;
+    }
+    ret.bandwidth = Mat2D<double>(n, n, -1);
+    ret.hops = Mat2D<int64_t>(n, n, -1);
+
+    std::vector<double> width;
+    std::vector<uint32_t> parent;
+    std::vector<uint32_t> worklist(n);
+    for (int64_t i = 0; i < n; ++i) {
+      widest_tree(i, width, parent);
+      for (int64_t j = 0; j < n; ++j) {
+        if (parent[j] != NONE) {
+          ret.bandwidth(i, j) = width[j];
+        }
+      }
+
+      // breadth-first search for hop counts
+      size_t head = 0, tail = 0;
+      ret.hops(i, i) = 0;
+      worklist[tail++] = i;
+      while (head < tail) {
+        const uint32_t u = worklist[head++];
+        for (const Adj *a = adj_begin(u); a != adj_end(u); ++a) {
+          if (ret.hops(i, a->vertex) < 0) {
+            ret.hops(i, a->vertex) = ret.hops(i, u) + 1;
+            worklist[tail++] = a->vertex;
+          }
+        }
+      }
+    }
+    return ret;
+  }
+
+private:
+  /* PathEnumerator's search over edge ids: call f with each path from src to
+     dst. A partial path is an arena node pointing at its prefix, and f gets
+     one EdgePath rebuilt in place for each path
+  */
+  template <typename F>
+  void for_each_path(uint32_t src, uint32_t dst, F f) const {
+    if (src == NONE || dst == NONE) {
+      return;
+    }
+    struct Node {
+      uint32_t edge;   // last edge of the path
+      uint32_t prefix; // node of the path without edge, or NONE
+    };
+    std::vector<char> visited(edges_.size(), 0);
+    std::vector<Node> arena;
+    std::vector<uint32_t> worklist;
+    auto push = [&](uint32_t prefix, uint32_t e) {
+      if (visited[e]) {
+        return;
+      }
+      visited[e] = 1;
+      Node node = {e, prefix};
+      arena.push_back(node);
+      worklist.push_back(arena.size() - 1);
+    };
+
+    // the first edge of src is searched first
+    for (const Adj *a = adj_end(src); a != adj_begin(src);) {
+      --a;
+      push(NONE, a->edge);
+    }
+
+    EdgePath path;
+    while (!worklist.empty()) {
+      const uint32_t n = worklist.back();
+      worklist.pop_back();
+
+      const uint32_t u = edgeU_[arena[n].edge];
+      const uint32_t v = edgeV_[arena[n].edge];
+      if (u == dst || v == dst) {
+        path.clear();
+        for (uint32_t m = n; m != NONE; m = arena[m].prefix) {
+          path.push_back(arena[m].edge);
+        }
+        std::reverse(path.begin(), path.end());
+        f(path);
+        continue;
+      }
+      for (uint32_t w : {u, v}) {
+        for (const Adj *a = adj_begin(w); a != adj_end(w); ++a) {
+          push(n, a->edge);
+        }
+      }
+    }
+  }
+
+  /* the path from src to dst that cost orders first by cmp. each path's cost
+     is computed once and only the best path is kept
+  */
+  template <typename Compare>
+  EdgePath best_path(uint32_t src, uint32_t dst,
+                     const std::function<float(const EdgePath &)> &cost,
+                     Compare cmp) const {
+    EdgePath best;
+    float bestCost = 0;
+    for_each_path(src, dst, [&](const EdgePath &p) {
+      const float c = cost(p);
+      if (best.empty() || cmp(c, bestCost)) {
+        best = p;
+        bestCost = c;
+      }
+    });
+    return best;
+  }
+
+  uint64_t version_;
+
+  std::vector<Vertex_t> vertices_;
+  std::vector<Vertex::Type> vertexTypes_;
+  std::map<Vertex_t, uint32_t> vertexIds_;
+
+  std::vector<uint32_t> offsets_;
+  std::vector<Adj> adj_;
+
+  std::vector<Edge_t> edges_;
+  std::map<Edge_t, uint32_t> edgeIds_;
+  std::vector<uint32_t> edgeU_;
+  std::vector<uint32_t> edgeV_;
+  std::vector<Edge::Type> edgeTypes_;
+  std::vector<double> bandwidth_;
+};
+
+/* Build a frozen CSR copy of g for read-only path queries
+ */
+inline CsrGraph freeze(const Graph &g) { return CsrGraph(g); }
+
+} // namespace hwgraph
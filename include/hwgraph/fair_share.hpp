@@ -0,0 +1,313 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include "csr.hpp"
+#include "graph.hpp"
+
+namespace hwgraph {
+
+/* how a flow without an explicit path is routed
+ */
+enum class Routing {
+  Widest, // CsrGraph::widest_path
+  Hops,   // fewest edges
+};
+
+/* one transfer sharing the graph with others
+ */
+struct FairFlow {
+  uint32_t src;
+  uint32_t dst;
+  EdgePath path; // from src to dst. empty: routed by the solver
+};
+
+/* Max-min fair rates for concurrent flows, by progressive filling.
+
+   Each direction of an edge is a link of Edge::bandwidth() bytes/s. All
+   flows grow together until some link is full; the flows through it are
+   fixed at that link's fair share and the rest keep growing. Edges without
+   a bandwidth model have no capacity.
+
+   A FairShare keeps its buffers between solve() calls, so solving many
+   batches on one frozen graph does not reallocate.
+*/
+class FairShare {
+public:
+  explicit FairShare(const CsrGraph &g) : g_(g) {}
+
+  /* the rate of each flow in flows, in bytes/s. A flow from a vertex to
+     itself is unbounded, and a flow with no route gets 0. The reference is
+     valid until the next call
+  */
+  const std::vector<double> &solve(const std::vector<FairFlow> &flows,
+                                   Routing routing = Routing::Widest) {
+    all_.resize(flows.size());
+    for (uint32_t f = 0; f < flows.size(); ++f) {
+      all_[f] = f;
+    }
+    return solve(flows, all_, routing);
+  }
+
+  /* the rates of flows[which[0]], flows[which[1]], ... when only those flows
+     are running
+  */
+  const std::vector<double> &solve(const std::vector<FairFlow> &flows,
+                                   const std::vector<uint32_t> &which,
+                                   Routing routing = Routing::Widest) {
+    const uint32_t numLinks = 2 * g_.num_edges();
+    links(flows, which, routing);
+
+    // flows through each link
+    linkStart_.assign(numLinks + 1, 0);
+    for (uint32_t l : flowLinks_) {
+      ++linkStart_[l + 1];
+    }
+    for (uint32_t l = 0; l < numLinks; ++l) {
+      linkStart_[l + 1] += linkStart_[l];
+    }
+    linkFlows_.resize(flowLinks_.size());
+    pos_.assign(linkStart_.begin(), linkStart_.end() - 1);
+    for (uint32_t k = 0; k < which.size(); ++k) {
+      for (uint32_t i = flowStart_[k]; i < flowStart_[k + 1]; ++i) {
+        linkFlows_[pos_[flowLinks_[i]]++] = k;
+      }
+    }
+
+    remaining_.resize(numLinks);
+    stamp_.assign(numLinks, 0);
+    heap_.clear();
+    for (uint32_t l = 0; l < numLinks; ++l) {
+      remaining_[l] = std::max(g_.bandwidth(l / 2), 0.0);
+      push(l);
+    }
+
+    while (!heap_.empty()) {
+      std::pop_heap(heap_.begin(), heap_.end(), std::greater<Entry>());
+      const Entry top = heap_.back();
+      heap_.pop_back();
+      if (top.stamp != stamp_[top.link] || active_[top.link] == 0) {
+        continue; // stale entry
+      }
+
+      // every unfixed flow through the fullest link gets its fair share
+      const double share = std::max(top.share, 0.0);
+      for (uint32_t i = linkStart_[top.link]; i < linkStart_[top.link + 1];
+           ++i) {
+        const uint32_t k = linkFlows_[i];
+        if (rates_[k] >= 0) {
+          continue;
+        }
+        rates_[k] = share;
+        for (uint32_t j = flowStart_[k]; j < flowStart_[k + 1]; ++j) {
+          const uint32_t l = flowLinks_[j];
+          remaining_[l] -= share;
+          --active_[l];
+          ++stamp_[l];
+          push(l);
+        }
+      }
+    }
+    return rates_;
+  }
+
+  /* fill in the path of every flow that has none, so later solves don't
+     route it again. Flows with no route are left empty
+  */
+  void route(std::vector<FairFlow> &flows, Routing routing = Routing::Widest) {
+    all_.resize(flows.size());
+    for (uint32_t f = 0; f < flows.size(); ++f) {
+      all_[f] = f;
+    }
+    routes(flows, all_, routing);
+    for (const auto &p : tmp_) {
+      flows[p.first].path.push_back(p.second / 2);
+    }
+    for (uint32_t f : routed_) {
+      std::reverse(flows[f].path.begin(), flows[f].path.end());
+    }
+  }
+
+  /* link 2e carries edge e from edge_u(e) to edge_v(e), and 2e+1 back
+   */
+  uint32_t link(uint32_t e, uint32_t from) const {
+    return 2 * e + (g_.edge_u(e) == from ? 0 : 1);
+  }
+
+private:
+  struct Entry {
+    double share; // remaining capacity over active flows when pushed
+    uint32_t link;
+    uint32_t stamp; // stamp_[link] when pushed
+    bool operator>(const Entry &rhs) const { return share > rhs.share; }
+  };
+
+  void push(uint32_t l) {
+    if (active_[l] > 0) {
+      Entry e = {remaining_[l] / active_[l], l, stamp_[l]};
+      heap_.push_back(e);
+      std::push_heap(heap_.begin(), heap_.end(), std::greater<Entry>());
+    }
+  }
+
+  /* route the flows in which that have no path, appending (k, link) to tmp_
+     for each link of flows[which[k]] from dst back to src. routed_ gets the
+     positions k that were routed. Flows that need no links get their rate
+  */
+  void routes(const std::vector<FairFlow> &flows,
+              const std::vector<uint32_t> &which, Routing routing) {
+    rates_.assign(which.size(), -1);
+    tmp_.clear();
+
+    // grouped by source so each source is searched once
+    routed_.clear();
+    for (uint32_t k = 0; k < which.size(); ++k) {
+      const FairFlow &flow = flows[which[k]];
+      if (flow.src == flow.dst) {
+        rates_[k] = std::numeric_limits<double>::infinity();
+      } else if (flow.path.empty()) {
+        routed_.push_back(k);
+      }
+    }
+    std::sort(routed_.begin(), routed_.end(), [&](uint32_t a, uint32_t b) {
+      return flows[which[a]].src < flows[which[b]].src;
+    });
+
+    for (size_t i = 0; i < routed_.size(); ++i) {
+      const uint32_t k = routed_[i];
+      const FairFlow &flow = flows[which[k]];
+      if (i == 0 || flows[which[routed_[i - 1]]].src != flow.src) {
+        tree(flow.src, routing);
+      }
+      if (parent_[flow.dst] == CsrGraph::NONE) {
+        rates_[k] = 0; // unreachable
+        continue;
+      }
+      for (uint32_t v = flow.dst; v != flow.src;) {
+        const uint32_t e = parent_[v];
+        v = g_.other_vertex(e, v);
+        tmp_.push_back(std::make_pair(k, link(e, v)));
+      }
+    }
+  }
+
+  /* fill flowStart_ and flowLinks_ with the links each flow in which uses
+   */
+  void links(const std::vector<FairFlow> &flows,
+             const std::vector<uint32_t> &which, Routing routing) {
+    const uint32_t n = which.size();
+    routes(flows, which, routing);
+    for (uint32_t k = 0; k < n; ++k) {
+      const FairFlow &flow = flows[which[k]];
+      if (rates_[k] < 0 && !flow.path.empty()) {
+        uint32_t v = flow.src;
+        for (uint32_t e : flow.path) {
+          assert(g_.edge_u(e) == v || g_.edge_v(e) == v);
+          tmp_.push_back(std::make_pair(k, link(e, v)));
+          v = g_.other_vertex(e, v);
+        }
+        assert(v == flow.dst);
+      }
+    }
+
+    // bucket tmp_ by flow
+    active_.assign(2 * g_.num_edges(), 0);
+    flowStart_.assign(n + 1, 0);
+    for (const auto &p : tmp_) {
+      ++flowStart_[p.first + 1];
+      ++active_[p.second];
+    }
+    for (uint32_t k = 0; k < n; ++k) {
+      flowStart_[k + 1] += flowStart_[k];
+    }
+    flowLinks_.resize(tmp_.size());
+    pos_.assign(flowStart_.begin(), flowStart_.end() - 1);
+    for (const auto &p : tmp_) {
+      flowLinks_[pos_[p.first]++] = p.second;
+    }
+  }
+
+  /* fill parent_ with a routing tree from src
+   */
+  void tree(uint32_t src, Routing routing) {
+    switch (routing) {
+    case Routing::Widest:
+      g_.widest_tree(src, width_, parent_);
+      return;
+    case Routing::Hops: {
+      parent_.assign(g_.num_vertices(), CsrGraph::NONE);
+      worklist_.resize(g_.num_vertices());
+      size_t head = 0, tail = 0;
+      worklist_[tail++] = src;
+      while (head < tail) {
+        const uint32_t u = worklist_[head++];
+        for (const CsrGraph::Adj *a = g_.adj_begin(u); a != g_.adj_end(u);
+             ++a) {
+          if (a->vertex != src && parent_[a->vertex] == CsrGraph::NONE) {
+            parent_[a->vertex] = a->edge;
+            worklist_[tail++] = a->vertex;
+          }
+        }
+      }
+      return;
+    }
+    }
+  }
+
+  const CsrGraph &g_;
+
+  std::vector<double> rates_; // by position in which, -1 until fixed
+
+  // links used by flow k are flowLinks_[flowStart_[k], flowStart_[k+1])
+  std::vector<uint32_t> flowStart_;
+  std::vector<uint32_t> flowLinks_;
+  // flows using link l are linkFlows_[linkStart_[l], linkStart_[l+1])
+  std::vector<uint32_t> linkStart_;
+  std::vector<uint32_t> linkFlows_;
+
+  std::vector<double> remaining_; // unallocated capacity of each link
+  std::vector<uint32_t> active_;  // unfixed flows through each link
+  std::vector<uint32_t> stamp_;   // bumped when a link's share changes
+  std::vector<Entry> heap_;       // links by fair share, smallest on top
+
+  // scratch
+  std::vector<uint32_t> all_;
+  std::vector<uint32_t> routed_;
+  std::vector<std::pair<uint32_t, uint32_t>> tmp_; // (flow, link)
+  std::vector<uint32_t> pos_;
+  std::vector<double> width_;
+  std::vector<uint32_t> parent_;
+  std::vector<uint32_t> worklist_;
+};
+
+/* max-min fair rates of flows over g, in bytes/s
+ */
+inline std::vector<double> fair_share(const CsrGraph &g,
+                                      const std::vector<FairFlow> &flows,
+                                      Routing routing = Routing::Widest) {
+  FairShare solver(g);
+  return solver.solve(flows, routing);
+}
+
+/* max-min fair rates of (src, dst) flows over g, each routed by routing
+ */
+inline std::vector<double>
+fair_share(const Graph &g,
+           const std::vector<std::pair<Vertex_t, Vertex_t>> &flows,
+           Routing routing = Routing::Widest) {
+  CsrGraph c = freeze(g);
+  std::vector<FairFlow> ff(flows.size());
+  for (size_t i = 0; i < flows.size(); ++i) {
+    ff[i].src = c.id(flows[i].first);
+    ff[i].dst = c.id(flows[i].second);
+  }
+  return fair_share(c, ff, routing);
+}
+
+} // namespace hwgraph
@@ -0,0 +1,198 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "csr.hpp"
+#include "graph.hpp"
+
+namespace hwgraph {
+
+/* the answer to a max_flow() query
+ */
+struct MaxFlow {
+  int64_t value;                // bytes/s from the sources to the sinks
+  std::vector<Edge_t> cut;      // saturated edges of a minimum cut
+  std::vector<uint32_t> cutIds; // the same edges, as CsrGraph edge ids
+};
+
+/* Dinic's maximum flow on a CsrGraph.
+
+   Each edge is full duplex: it can carry bandwidth() bytes/s in each
+   direction at once. Edges without a bandwidth model carry nothing.
+*/
+class FlowNetwork {
+public:
+  explicit FlowNetwork(const CsrGraph &g)
+      : g_(g), n_(g.num_vertices() + 2), head_(n_, NONE) {
+    for (uint32_t e = 0; e < g.num_edges(); ++e) {
+      const double bw = g.bandwidth(e);
+      const int64_t cap = bw > 0 ? int64_t(std::llround(bw)) : 0;
+      add_arc(g.edge_u(e), g.edge_v(e), cap);
+      add_arc(g.edge_v(e), g.edge_u(e), cap);
+    }
+    base_ = arcs_.size();
+  }
+
+  /* max flow from any vertex in sources to any vertex in sinks. The sets
+     must not overlap. CsrGraph::NONE ids, for vertices not in the graph,
+     are skipped
+  */
+  MaxFlow max_flow(const std::vector<uint32_t> &sources,
+                   const std::vector<uint32_t> &sinks) {
+    reset();
+    const uint32_t s = n_ - 2;
+    const uint32_t t = n_ - 1;
+    for (uint32_t v : sources) {
+      if (v == CsrGraph::NONE) {
+        continue;
+      }
+      assert(std::find(sinks.begin(), sinks.end(), v) == sinks.end());
+      add_arc(s, v, INF);
+    }
+    for (uint32_t v : sinks) {
+      if (v != CsrGraph::NONE) {
+        add_arc(v, t, INF);
+      }
+    }
+
+    MaxFlow ret;
+    ret.value = 0;
+    while (levels(s, t)) {
+      iter_.assign(head_.begin(), head_.end());
+      while (int64_t f = augment(s, t, INF)) {
+        ret.value += f;
+      }
+    }
+
+    // the cut is between the vertices still reachable from s and the rest
+    levels(s, t);
+    for (uint32_t e = 0; e < g_.num_edges(); ++e) {
+      const bool u = level_[g_.edge_u(e)] >= 0;
+      const bool v = level_[g_.edge_v(e)] >= 0;
+      // the arc from the source side, which max flow saturates
+      if (u != v && arcs_[u ? 4 * e : 4 * e + 2].orig > 0) {
+        ret.cutIds.push_back(e);
+        ret.cut.push_back(g_.edge(e));
+      }
+    }
+    return ret;
+  }
+
+private:
+  enum : uint32_t { NONE = 0xffffffff };
+  enum : int64_t { INF = std::numeric_limits<int64_t>::max() / 4 };
+
+  struct Arc {
+    uint32_t to;
+    uint32_t next; // next arc out of the same vertex
+    int64_t cap;   // residual capacity
+    int64_t orig;  // capacity before any flow
+  };
+
+  // arcs 2k and 2k+1 are each other's reverse, with the reverse starting
+  // at 0 capacity. Arcs 4e and 4e+2 are the two directions of edge e
+  void add_arc(uint32_t u, uint32_t v, int64_t cap) {
+    Arc a = {v, head_[u], cap, cap};
+    head_[u] = arcs_.size();
+    arcs_.push_back(a);
+    Arc r = {u, head_[v], 0, 0};
+    head_[v] = arcs_.size();
+    arcs_.push_back(r);
+  }
+
+  /* drop the super source and sink arcs and any flow from the last query
+   */
+  void reset() {
+    while (arcs_.size() > base_) {
+      const Arc &r = arcs_.back();
+      const Arc &a = arcs_[arcs_.size() - 2];
+      head_[a.to] = r.next;
+      head_[r.to] = a.next;
+      arcs_.resize(arcs_.size() - 2);
+    }
+    for (Arc &a : arcs_) {
+      a.cap = a.orig;
+    }
+  }
+
+  /* breadth-first levels over arcs with residual capacity. true if t is
+     reachable from s
+  */
+  bool levels(uint32_t s, uint32_t t) {
+    level_.assign(n_, -1);
+    queue_.resize(n_);
+    size_t head = 0, tail = 0;
+    level_[s] = 0;
+    queue_[tail++] = s;
+    while (head < tail) {
+      const uint32_t u = queue_[head++];
+      for (uint32_t a = head_[u]; a != NONE; a = arcs_[a].next) {
+        if (arcs_[a].cap > 0 && level_[arcs_[a].to] < 0) {
+          level_[arcs_[a].to] = level_[u] + 1;
+          queue_[tail++] = arcs_[a].to;
+        }
+      }
+    }
+    return level_[t] >= 0;
+  }
+
+  /* push up to limit along one level-increasing path from u to t
+   */
+  int64_t augment(uint32_t u, uint32_t t, int64_t limit) {
+    if (u == t) {
+      return limit;
+    }
+    for (uint32_t &a = iter_[u]; a != NONE; a = arcs_[a].next) {
+      Arc &arc = arcs_[a];
+      if (arc.cap > 0 && level_[arc.to] == level_[u] + 1) {
+        const int64_t f = augment(arc.to, t, std::min(limit, arc.cap));
+        if (f > 0) {
+          arc.cap -= f;
+          arcs_[a ^ 1].cap += f;
+          return f;
+        }
+      }
+    }
+    return 0;
+  }
+
+  const CsrGraph &g_;
+  uint32_t n_; // graph vertices, then the super source and sink
+  std::vector<uint32_t> head_;
+  std::vector<Arc> arcs_;
+  size_t base_; // arcs_ before any super source or sink arcs
+  std::vector<int> level_;
+  std::vector<uint32_t> queue_;
+  std::vector<uint32_t> iter_;
+};
+
+/* max flow from sources to sinks over g, with Edge::bandwidth() capacities
+   in each direction of every edge
+*/
+inline MaxFlow max_flow(const CsrGraph &g, const std::vector<uint32_t> &sources,
+                        const std::vector<uint32_t> &sinks) {
+  FlowNetwork net(g);
+  return net.max_flow(sources, sinks);
+}
+
+/* max flow between vertices of g. Vertices not in g are skipped
+ */
+inline MaxFlow max_flow(const Graph &g, const std::vector<Vertex_t> &sources,
+                        const std::vector<Vertex_t> &sinks) {
+  CsrGraph f = freeze(g);
+  std::vector<uint32_t> s, t;
+  for (const Vertex_t &v : sources) {
+    s.push_back(f.id(v));
+  }
+  for (const Vertex_t &v : sinks) {
+    t.push_back(f.id(v));
+  }
+  return max_flow(f, s, t);
+}
+
+} // namespace hwgraph
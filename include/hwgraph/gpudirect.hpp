@@ -0,0 +1,78 @@
+#pragma once
+
+#include <utility>
+
+#include "graph.hpp"
+
+/* Pairing devices with the NICs and drives closest to them, such as for
+   GPUDirect RDMA and GPUDirect Storage.
+
+   Peer-to-peer DMA between PCI devices is fastest when it stays below a
+   host bridge, and is slow or unsupported once it has to go through a CPU,
+   so paths that avoid packages are preferred over shorter ones that don't.
+   The DMA itself only moves over PCIe, so paths only follow Pci edges: an
+   NVLink to a GPU next to the NIC, or the link between sockets, does not
+   bring a device closer
+*/
+
+namespace hwgraph {
+
+/* true if p passes through a package
+ */
+inline bool crosses_cpu(const Path &p) {
+  for (const Edge_t &e : p) {
+    if (Vertex::is_package(e->u_) || Vertex::is_package(e->v_)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/* The vertex of type t closest to v over Pci edges, and the fewest-hops
+   path to it. Prefers paths that don't cross a CPU, then fewer hops, then
+   the widest bottleneck. nullptr and an empty path if no vertex of type t is
+   reachable
+*/
+inline std::pair<Path, Vertex_t> closest_of_type(Graph &g, const Vertex_t &v,
+                                                 Vertex::Type t) {
+  std::pair<Path, Vertex_t> best;
+  bool bestCrosses = true;
+  double bestBw = -1;
+  for (const Vertex_t &c : g.vertices()) {
+    if (c->type_ != t || c == v) {
+      continue;
+    }
+    Path p;
+    if (!g.shortest_path(
+            v, [&](const Vertex_t &u) { return u == c; },
+            [](const Edge_t &e) { return e->type_ == Edge::Type::Pci; }, p)) {
+      continue;
+    }
+    const bool crosses = crosses_cpu(p);
+    const double bw = path_cost<cost::Bottleneck>(p);
+    if (!best.second || (!crosses && bestCrosses) ||
+        (crosses == bestCrosses &&
+         (p.size() < best.first.size() ||
+          (p.size() == best.first.size() && bw > bestBw)))) {
+      best = std::make_pair(p, c);
+      bestCrosses = crosses;
+      bestBw = bw;
+    }
+  }
+  return best;
+}
+
+/* the NIC closest to v. See closest_of_type
+ */
+inline std::pair<Path, Vertex_t> closest_nic(Graph &g, const Vertex_t &v) {
+  return closest_of_type(g, v, Vertex::Type::Nic);
+}
+
+/* the storage device closest to v. See closest_of_type
+ */
+inline std::pair<Path, Vertex_t> closest_storage(Graph &g,
+                                                 const Vertex_t &v) {
+  return closest_of_type(g, v, Vertex::Type::Storage);
+}
+
+} // namespace hwgraph
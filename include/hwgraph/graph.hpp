@@ -7,13 +7,21 @@
 #include <functional>
 #include <iomanip>
 #include <iostream>
+#include <limits>
+#include <map>
 #include <memory>
+#include <queue>
 #include <set>
 #include <sstream>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include "config.hpp"
 #include "dot_label.hpp"
+#include "link_bandwidth.hpp"
+#include "link_latency.hpp"
+#include "mat2d.hpp"
 #include "pci_address.hpp"
 #include "vertex_data.hpp"
 
@@ -36,6 +44,12 @@ struct Vertex {
     Gpu,
     NvLinkBridge,
     NvSwitch,
+    NumaNode,
+    L3, // an L3 cache and the cores that share it
+    Core,
+    Nic,         // PCI device with network or OpenFabrics OS devices
+    Storage,     // PCI device with block OS devices
+    Coprocessor, // PCI device with co-processor OS devices
   } type_;
 
   std::set<Edge_t> edges_;
@@ -50,14 +64,22 @@ struct Vertex {
       PciAddress domain;
       PciAddress secondaryBus;
       PciAddress subordinateBus;
+      Locality locality; // set on host bridges
     } bridge_;
     PciDeviceData pciDev;
     GpuData gpu;
     NvLinkBridgeData nvLinkBridge;
     NvSwitchData nvSwitch;
+    NumaNodeData numaNode;
+    L3Data l3;
+    CoreData core;
+    OsDeviceData osDev; // Nic, Storage and Coprocessor
   } data_;
 
-  Vertex(Type type) : type_(type), data_({}) {}
+  Vertex(Type type) : type_(type) {
+    // zero all of data_, not just its first member
+    std::memset(&data_, 0, sizeof(data_));
+  }
   Vertex() : Vertex(Type::Unknown) {}
 
   static Vertex_t new_bridge(const char *name, const PciAddress &addr,
@@ -120,7 +142,61 @@ struct Vertex {
 
   bool is_pci_device() const noexcept {
     return type_ == Type::PciDev || type_ == Type::Gpu ||
-           type_ == Type::NvLinkBridge || type_ == Type::NvSwitch;
+           type_ == Type::NvLinkBridge || type_ == Type::NvSwitch ||
+           type_ == Type::Nic || type_ == Type::Storage ||
+           type_ == Type::Coprocessor;
+  }
+
+  /* the PCI address of this vertex, or nullptr if it does not have one
+   */
+  const PciAddress *pci_address() const noexcept {
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wswitch-enum"
+    switch (type_) {
+    case Type::Bridge:
+      return &data_.bridge_.addr;
+    case Type::PciDev:
+      return &data_.pciDev.addr;
+    case Type::Gpu:
+      return &data_.gpu.pciDev.addr;
+    case Type::NvLinkBridge:
+      return &data_.nvLinkBridge.pciDev.addr;
+    case Type::Nic:
+    case Type::Storage:
+    case Type::Coprocessor:
+      return &data_.osDev.pciDev.addr;
+    default:
+      return nullptr;
+    }
+#pragma GCC diagnostic pop
+  }
+
+  /* the CPUs and NUMA nodes of a package, host bridge, NUMA node, L3 or
+     core, or nullptr for other vertices
+  */
+  const Locality *locality() const noexcept {
+    return const_cast<Vertex *>(this)->locality();
+  }
+  Locality *locality() noexcept {
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wswitch-enum"
+    switch (type_) {
+    case Type::Intel:
+      return &data_.intel.locality;
+    case Type::Ppc:
+      return &data_.ppc_.locality;
+    case Type::Bridge:
+      return &data_.bridge_.locality;
+    case Type::NumaNode:
+      return &data_.numaNode.locality;
+    case Type::L3:
+      return &data_.l3.locality;
+    case Type::Core:
+      return &data_.core.locality;
+    default:
+      return nullptr;
+    }
+#pragma GCC diagnostic pop
   }
 
   static bool is_package(const Vertex_t v) noexcept {
@@ -141,6 +217,9 @@ struct Vertex {
       s += ",dom=" + data_.bridge_.domain.str();
       s += ",sec=" + data_.bridge_.secondaryBus.str();
       s += ",sub=" + data_.bridge_.subordinateBus.str();
+      if (!data_.bridge_.locality.empty()) {
+        s += ",locality=" + data_.bridge_.locality.str();
+      }
       break;
     }
     case Type::PciDev:
@@ -165,6 +244,30 @@ struct Vertex {
       s += data_.ppc_.str();
       break;
     }
+    case Type::NumaNode:
+      s += ", type: numanode, ";
+      s += "numanode: " + data_.numaNode.str();
+      break;
+    case Type::L3:
+      s += ", type: l3, ";
+      s += "l3: " + data_.l3.str();
+      break;
+    case Type::Core:
+      s += ", type: core, ";
+      s += "core: " + data_.core.str();
+      break;
+    case Type::Nic:
+      s += ", type: nic, ";
+      s += "osdev: " + data_.osDev.str();
+      break;
+    case Type::Storage:
+      s += ", type: storage, ";
+      s += "osdev: " + data_.osDev.str();
+      break;
+    case Type::Coprocessor:
+      s += ", type: coprocessor, ";
+      s += "osdev: " + data_.osDev.str();
+      break;
     case Type::Unknown: {
       s += ", type: unknown";
       break;
@@ -221,6 +324,8 @@ struct Edge {
     Xbus,
     Pci,
     Nvlink,
+    Memory, // a package to the memory of a NUMA node
+    Onchip, // within a package: to an L3 or a core. No bandwidth model
   } type_;
 
   Vertex_t u_;
@@ -241,9 +346,14 @@ struct Edge {
       unsigned int version;
       int64_t lanes;
     } nvlink;
+    struct MemoryData {
+      int64_t bw_; // bytes/s, 0 if unknown
+    } memory_;
   } data_;
 
-  Edge(Type type) : type_(type), u_(nullptr), v_(nullptr) {
+  double latency_; // seconds, or negative to use default_latency()
+
+  Edge(Type type) : type_(type), u_(nullptr), v_(nullptr), latency_(-1) {
     std::memset(&data_, 0, sizeof(data_));
   }
   Edge() : Edge(Type::Unknown) {}
@@ -255,6 +365,16 @@ struct Edge {
     return e;
   }
 
+  /* a PCIe link of a known generation and width
+   */
+  static Edge_t new_pcie(unsigned int generation, int64_t lanes) {
+    auto e = new_pci(pcie_bandwidth(generation, lanes) / 1e9);
+    e->data_.pci.lanes = lanes;
+    return e;
+  }
+
+  /* lanes NVLinks of the nvmlNvlinkVersion_t version NVML reports
+   */
   static Edge_t new_nvlink(unsigned int version, int64_t lanes) {
     auto e = std::make_shared<Edge>(Edge::Type::Nvlink);
     e->data_.nvlink.version = version;
@@ -268,6 +388,16 @@ struct Edge {
     return e;
   }
 
+  /* from a package to a NUMA node's memory. bw is bytes/s, 0 if unknown
+   */
+  static Edge_t new_memory(int64_t bw) {
+    auto e = std::make_shared<Edge>(Edge::Type::Memory);
+    e->data_.memory_.bw_ = bw;
+    return e;
+  }
+
+  static Edge_t new_onchip() { return std::make_shared<Edge>(Type::Onchip); }
+
   bool has_vertex(const Vertex_t v) const noexcept {
     return (u_ == v || v_ == v);
   }
@@ -297,16 +427,39 @@ struct Edge {
     return false;
   }
 
-  int64_t bandwidth() {
+  /* true if bandwidth() is modeled for this edge type
+   */
+  bool has_bandwidth() const noexcept {
+    return type_ == Type::Qpi || type_ == Type::Xbus || type_ == Type::Pci ||
+           (type_ == Type::Nvlink && data_.nvlink.version > 0 &&
+            data_.nvlink.version <= NVLINK_MAX_VERSION) ||
+           (type_ == Type::Memory && data_.memory_.bw_ > 0);
+  }
+
+  /* bytes per second in each direction. See link_bandwidth.hpp
+   */
+  int64_t bandwidth() const {
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wswitch-enum"
     switch (type_) {
     case Type::Qpi:
-      return data_.qpi_.links_ * data_.qpi_.speed_;
+      // each link moves 2 bytes per transfer in each direction
+      return data_.qpi_.links_ * data_.qpi_.speed_ * 2;
     case Type::Xbus:
       return data_.xbus_.bw_;
     case Type::Pci:
-      return data_.pci.linkSpeed;
+      // linkSpeed is GB/s for the whole link, as hwloc reports it. Without
+      // it, assume the lanes are gen 3
+      if (data_.pci.linkSpeed > 0) {
+        return int64_t(double(data_.pci.linkSpeed) * 1e9);
+      }
+      return pcie_bandwidth(3, data_.pci.lanes);
+    case Type::Nvlink:
+      assert(has_bandwidth() && "unknown nvlink version");
+      return nvlink_bandwidth(data_.nvlink.version, data_.nvlink.lanes);
+    case Type::Memory:
+      assert(has_bandwidth() && "unknown memory bandwidth");
+      return data_.memory_.bw_;
     case Type::Unknown:
       assert(0 && "bandwidth() called on unknown edge");
       return -1;
@@ -317,6 +470,55 @@ struct Edge {
 #pragma GCC diagnostic pop
   }
 
+  /* true if latency() is known or modeled for this edge
+   */
+  bool has_latency() const noexcept {
+    return latency_ >= 0 || (type_ != Type::Unknown && type_ != Type::Onchip);
+  }
+
+  /* one-way latency in seconds
+   */
+  double latency() const { return latency_ >= 0 ? latency_ : default_latency(); }
+
+  /* the latency of a typical link of this type. See link_latency.hpp
+   */
+  double default_latency() const {
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wswitch-enum"
+    switch (type_) {
+    case Type::Qpi:
+      return QPI_LATENCY;
+    case Type::Xbus:
+      return XBUS_LATENCY;
+    case Type::Pci:
+      // a link to a package crosses the root complex
+      if ((u_ && Vertex::is_package(u_)) || (v_ && Vertex::is_package(v_))) {
+        return PCIE_ROOT_COMPLEX_LATENCY;
+      }
+      return PCIE_SWITCH_HOP_LATENCY;
+    case Type::Nvlink:
+      return NVLINK_LATENCY;
+    case Type::Memory:
+      return MEMORY_LATENCY;
+    case Type::Unknown:
+      assert(0 && "latency() called on unknown edge");
+      return -1;
+    default:
+      assert(0 && "unhandled edge Type");
+      return -1;
+    }
+#pragma GCC diagnostic pop
+  }
+
+  /* the PCIe generation of a Pci edge, inferred from its bandwidth and lane
+     count. 0 if the lane count is unknown
+  */
+  unsigned int pci_generation() const {
+    assert(type_ == Type::Pci);
+    return pcie_generation(double(data_.pci.linkSpeed) * 1e9,
+                           data_.pci.lanes);
+  }
+
   std::string str() const {
     std::string s = "{";
 
@@ -334,6 +536,15 @@ struct Edge {
       s += "linkSpeed: " + std::to_string(data_.pci.linkSpeed);
       break;
     }
+    case Type::Memory: {
+      s += "type: memory, ";
+      s += "bw: " + std::to_string(data_.memory_.bw_);
+      break;
+    }
+    case Type::Onchip: {
+      s += "type: onchip";
+      break;
+    }
     case Type::Unknown: {
       s += "type: unknown";
       break;
@@ -365,6 +576,10 @@ struct Edge {
           .str();
     case Type::Xbus:
       return DotLabel("xbus").str();
+    case Type::Memory:
+      return DotLabel("memory").str();
+    case Type::Onchip:
+      return DotLabel("onchip").str();
     case Type::Unknown:
       return DotLabel("unknown").str();
     default:
@@ -405,26 +620,282 @@ struct VertexEq {
 
 typedef std::vector<Edge_t> Path;
 
+/* narrowest bandwidth along p in bytes/s. -1 if p is empty or has an edge
+   without a bandwidth model, as cost::Bottleneck
+*/
 inline double path_bandwidth(const Path &p) {
   if (p.empty()) {
     return -1;
-  } else {
-    auto cmp_bandwidth = [](const Edge_t &a, const Edge_t &b) {
-      return a->bandwidth() < b->bandwidth();
-    };
-    auto it = std::min_element(p.begin(), p.end(), cmp_bandwidth);
-    assert(it != p.end());
-    return (*it)->bandwidth();
   }
+  double ret = std::numeric_limits<double>::infinity();
+  for (const Edge_t &e : p) {
+    if (!e->has_bandwidth()) {
+      return -1;
+    }
+    ret = std::min(ret, double(e->bandwidth()));
+  }
+  return ret;
+}
+
+/* one-way latency of p in seconds, 0 if it is empty. Infinity if p has an
+   edge without a latency model, as cost::Latency
+*/
+inline double path_latency(const Path &p) {
+  double ret = 0;
+  for (const Edge_t &e : p) {
+    if (!e->has_latency()) {
+      return std::numeric_limits<double>::infinity();
+    }
+    ret += e->latency();
+  }
+  return ret;
+}
+
+/* alpha-beta time in seconds to move bytes along p: its latency plus bytes
+   over its bottleneck bandwidth. 0 if p is empty, and infinity if p has an
+   edge without a bandwidth or latency model
+*/
+inline double path_time(const Path &p, double bytes) {
+  if (p.empty()) {
+    return 0;
+  }
+  const double bw = path_bandwidth(p);
+  if (bw <= 0) {
+    return std::numeric_limits<double>::infinity();
+  }
+  return path_latency(p) + bytes / bw;
+}
+
+/* Path cost policies for Graph::min_path<Cost>() and max_path<Cost>().
+
+   A policy builds the cost of a path one edge at a time:
+     value_type      the cost type
+     identity()      the cost of an empty path
+     edge(e)         the cost of the single edge e
+     combine(a, b)   the cost of a path of cost a extended by an edge of cost b
+     less(a, b)      the order of costs. min_path() minimizes it and
+                     max_path() maximizes it
+*/
+namespace cost {
+
+/* the narrowest bandwidth along the path, -1 for edges without a model
+ */
+struct Bottleneck {
+  typedef double value_type;
+  static value_type identity() {
+    return std::numeric_limits<double>::infinity();
+  }
+  static value_type edge(const Edge_t &e) {
+    return e->has_bandwidth() ? double(e->bandwidth()) : -1;
+  }
+  static value_type combine(value_type a, value_type b) {
+    return std::min(a, b);
+  }
+  static bool less(value_type a, value_type b) { return a < b; }
+};
+
+/* the sum of a non-negative per-edge weight. Weight is a default-constructible
+   functor from Edge_t to the weight
+*/
+template <typename Weight> struct Additive {
+  typedef decltype(Weight()(Edge_t())) value_type;
+  static value_type identity() { return value_type(0); }
+  static value_type edge(const Edge_t &e) { return Weight()(e); }
+  static value_type combine(value_type a, value_type b) { return a + b; }
+  static bool less(value_type a, value_type b) { return a < b; }
+};
+
+struct UnitWeight {
+  int64_t operator()(const Edge_t &) const { return 1; }
+};
+
+/* the number of edges in the path
+ */
+typedef Additive<UnitWeight> Hops;
+
+struct LatencyWeight {
+  double operator()(const Edge_t &e) const {
+    return e->has_latency() ? e->latency()
+                            : std::numeric_limits<double>::infinity();
+  }
+};
+
+/* the one-way latency of the path in seconds
+ */
+typedef Additive<LatencyWeight> Latency;
+
+} // namespace cost
+
+/* the cost of p under a cost policy
+ */
+template <typename Cost> typename Cost::value_type path_cost(const Path &p) {
+  typename Cost::value_type ret = Cost::identity();
+  for (const Edge_t &e : p) {
+    ret = Cost::combine(ret, Cost::edge(e));
+  }
+  return ret;
 }
 
+/* a path and its objectives, as returned by Graph::pareto_paths()
+ */
+struct ParetoPath {
+  Path path;
+  double bandwidth; // path_bandwidth(path)
+  double latency;   // path_latency(path)
+  int64_t hops;     // path.size()
+};
+
+/* all-pairs bottleneck bandwidth and hop count, indexed by the position of a
+   vertex in vertices
+*/
+struct PairMatrix {
+  uint64_t version; // Graph::version() this was computed for
+  std::vector<Vertex_t> vertices;
+  std::map<Vertex_t, int64_t> index;
+  Mat2D<double> bandwidth; // bandwidth of the widest path, -1 if none
+  Mat2D<int64_t> hops;     // fewest edges between vertices, -1 if none
+
+  PairMatrix() : version(0) {}
+
+  double bandwidth_between(const Vertex_t u, const Vertex_t v) const {
+    return bandwidth(index.at(u), index.at(v));
+  }
+  int64_t hops_between(const Vertex_t u, const Vertex_t v) const {
+    return hops(index.at(u), index.at(v));
+  }
+
+  /* bandwidth between vs[i] and vs[j] at (i, j)
+   */
+  Mat2D<double> bandwidth_among(const std::vector<Vertex_t> &vs) const {
+    Mat2D<double> ret(vs.size(), vs.size());
+    for (size_t i = 0; i < vs.size(); ++i) {
+      for (size_t j = 0; j < vs.size(); ++j) {
+        ret(i, j) = bandwidth_between(vs[i], vs[j]);
+      }
+    }
+    return ret;
+  }
+};
+
+/* Enumerates the paths Graph::paths() returns, one at a time.
+
+   A partial path is a node in an arena that points at its prefix, so
+   extending a path copies nothing and only yielded paths are built. Stop
+   calling next() to stop early. An optional Bound sees each prefix before it
+   is extended, and returning false prunes every path that starts with it.
+   The graph must not change while a PathEnumerator is in use.
+*/
+class PathEnumerator {
+public:
+  typedef std::function<bool(const Path &prefix)> Bound;
+  typedef std::unordered_map<const Edge *, uint32_t> EdgeIds;
+
+  /* edgeIds gives every edge of the graph a dense id
+   */
+  PathEnumerator(const EdgeIds &edgeIds, const Vertex_t &src,
+                 const Vertex_t &dst, Bound bound = Bound())
+      : edgeIds_(&edgeIds) {
+    reset(src, dst, std::move(bound));
+  }
+
+  /* start over from src to dst, reusing the storage of the last search
+   */
+  void reset(const Vertex_t &src, const Vertex_t &dst,
+             Bound bound = Bound()) {
+    dst_ = dst;
+    bound_ = std::move(bound);
+    arena_.clear();
+    worklist_.clear();
+    visited_.assign(edgeIds_->size(), 0);
+    if (!src) {
+      return;
+    }
+    // the first edge of src is searched first
+    for (auto it = src->edges_.rbegin(); it != src->edges_.rend(); ++it) {
+      push(NONE, *it);
+    }
+  }
+
+  /* store the next path in path and return true, or return false if there
+     are no more paths
+  */
+  bool next(Path &path) {
+    while (!worklist_.empty()) {
+      const uint32_t n = worklist_.back();
+      worklist_.pop_back();
+
+      const Edge_t &last = *arena_[n].edge;
+      if (last->u_ == dst_ || last->v_ == dst_) {
+        build(n, path);
+        return true;
+      }
+      for (const Edge_t &e : last->u_->edges_) {
+        push(n, e);
+      }
+      for (const Edge_t &e : last->v_->edges_) {
+        push(n, e);
+      }
+    }
+    path.clear();
+    return false;
+  }
+
+private:
+  enum : uint32_t { NONE = 0xffffffff }; // no prefix
+
+  struct Node {
+    const Edge_t *edge; // last edge of the path
+    uint32_t prefix;    // node of the path without edge, or NONE
+  };
+
+  void push(uint32_t prefix, const Edge_t &e) {
+    auto it = edgeIds_->find(e.get());
+    if (it == edgeIds_->end() || visited_[it->second]) {
+      return;
+    }
+    if (bound_) {
+      build(prefix, scratch_);
+      scratch_.push_back(e);
+      if (!bound_(scratch_)) {
+        return;
+      }
+    }
+    visited_[it->second] = 1;
+    Node node;
+    node.edge = &e;
+    node.prefix = prefix;
+    arena_.push_back(node);
+    worklist_.push_back(arena_.size() - 1);
+  }
+
+  void build(uint32_t n, Path &path) const {
+    path.clear();
+    for (; n != NONE; n = arena_[n].prefix) {
+      path.push_back(*arena_[n].edge);
+    }
+    std::reverse(path.begin(), path.end());
+  }
+
+  const EdgeIds *edgeIds_;
+  Vertex_t dst_;
+  Bound bound_;
+  std::vector<Node> arena_;
+  std::vector<uint32_t> worklist_; // arena nodes still to be searched
+  std::vector<char> visited_;      // by edge id
+  Path scratch_;                   // prefix passed to bound_
+};
+
 class Graph {
 
 public:
 
   /*! Build a new graph
    */
-  Graph() {}
+  Graph() : version_(1) {}
+
+  /* changes whenever a vertex or edge is added, removed, or replaced
+   */
+  uint64_t version() const noexcept { return version_; }
 
   const std::set<Edge_t> &edges() const { return edges_; }
   std::set<Edge_t> &edges() { return edges_; }
@@ -454,6 +925,10 @@ public:
 
   Vertex_t insert_vertex(Vertex_t v) {
     auto p = vertices_.insert(v);
+    if (p.second) {
+      index_pci(v);
+      ++version_;
+    }
     return *(p.first);
   }
 
@@ -472,6 +947,9 @@ public:
    */
   Edge_t insert_edge(Edge_t e) {
     auto p = edges_.insert(e);
+    if (p.second) {
+      ++version_;
+    }
     return *(p.first);
   }
 
@@ -503,6 +981,7 @@ public:
     u->edges_.insert(e);
     v->edges_.insert(e);
     auto ret = insert_edge(e);
+    ++version_;
     return ret;
   }
 
@@ -512,6 +991,7 @@ public:
     e->v_->edges_.erase(e);
     auto it = std::find(edges_.begin(), edges_.end(), e);
     edges_.erase(it);
+    ++version_;
     return e;
   }
 
@@ -533,15 +1013,11 @@ public:
   }
 
   Vertex_t replace(Vertex_t orig, Vertex_t next) {
-    std::cerr << "entry\n";
-    std::cerr << orig->str() << "\n";
-    std::cerr << next->str() << "\n";
     assert(orig);
     assert(next);
     assert(vertices_.count(orig));
 
     // replace all edges with orig to be next
-    std::cerr << "replace edges\n";
     for (auto &e : orig->edges_) {
       if (e->u_ == orig) {
         e->u_ = next;
@@ -552,17 +1028,19 @@ public:
     }
 
     // copy all orig edges to next
-    std::cerr << "copy edges\n";
     next->edges_ = orig->edges_;
 
     // add new vertex
     vertices_.insert(next);
+    unindex_pci(orig);
+    index_pci(next);
 
     // delete original vertex
     auto it = std::find(vertices_.begin(), vertices_.end(), orig);
     assert(it != vertices_.end());
     auto ret = *it;
     vertices_.erase(it);
+    ++version_;
 
     return ret;
   }
@@ -592,40 +1070,19 @@ public:
     return nullptr;
   }
 
-  Vertex_t get_pci(const PciAddress &address) {
-    for (const auto &v : vertices_) {
-      if (v->type_ == Vertex::Type::Bridge) {
-        PciAddress br = v->data_.bridge_.addr;
-        if (br.domain_ == address.domain_ && br.bus_ == address.bus_) {
-          return v;
-        }
-
-      } else if (v->type_ == Vertex::Type::PciDev) {
-        if (v->data_.pciDev.addr == address) {
-          return v;
-        }
-      } else if (v->type_ == Vertex::Type::Gpu) {
-        if (v->data_.gpu.pciDev.addr == address) {
-          return v;
-        }
-      } else if (v->type_ == Vertex::Type::NvLinkBridge) {
-        if (v->data_.nvLinkBridge.pciDev.addr == address) {
-          return v;
-        }
-      }
-    }
-    return nullptr;
+  /* the bridge or PCI device at exactly address, or nullptr
+   */
+  Vertex_t get_pci(const PciAddress &address) const {
+    auto it = pciIndex_.find(address.packed());
+    return it == pciIndex_.end() ? nullptr : it->second;
   }
 
-  Vertex_t get_bridge_for_address(const PciAddress &address) {
-    for (const auto &br : vertices<Vertex::Type::Bridge>()) {
-      if (br->data_.bridge_.domain.domain_ == address.domain_ &&
-          br->data_.bridge_.secondaryBus.bus_ == address.bus_) {
-        return br;
-      }
-    }
-
-    return nullptr;
+  /* the innermost bridge whose secondary..subordinate bus range contains the
+     bus of address, or nullptr
+  */
+  Vertex_t get_bridge_for_address(const PciAddress &address) const {
+    auto it = busIndex_.find(bus_key(address.domain_, address.bus_));
+    return it == busIndex_.end() ? nullptr : it->second;
   }
 
   template <typename T> void dump(const std::vector<T> v) {
@@ -639,147 +1096,462 @@ public:
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wnoexcept-type"
   /*
-    finds the shortest path from src to a vertex for which
-    UnaryPredicate(vertex) yields true
+    finds the shortest path from src to the nearest other vertex for which
+    UnaryPredicate(vertex) yields true, and stores it in path.
+    Returns that vertex, or nullptr if there is none.
+
+    Breadth-first search keeps one parent edge per vertex in buffers owned by
+    the graph, and only the winning path is built. Once the graph stops
+    changing, a search that reuses path does not allocate.
   */
   template <typename UnaryPredicate>
-  std::pair<Path, Vertex_t> shortest_path(const Vertex_t src,
-                                          UnaryPredicate p) {
-
-    std::set<Edge_t> visited; // the edges we have traversed
-    std::deque<Path> worklist;
+  Vertex_t shortest_path(const Vertex_t &src, UnaryPredicate p, Path &path) {
+    return shortest_path(src, p, [](const Edge_t &) { return true; }, path);
+  }
 
-    // initialize worklist
-    for (auto e : src->edges_) {
-      Path path = {e};
-      worklist.push_front(path);
-      visited.insert(e);
+  /* like shortest_path(src, p, path), but only through edges for which
+     EdgePredicate(edge) yields true
+  */
+  template <typename UnaryPredicate, typename EdgePredicate>
+  Vertex_t shortest_path(const Vertex_t &src, UnaryPredicate p,
+                         EdgePredicate follow, Path &path) {
+    path.clear();
+    SearchScratch &s = search_scratch();
+    auto it = s.ids.find(src.get());
+    if (it == s.ids.end()) {
+      return nullptr;
     }
 
-    while (!worklist.empty()) {
-
-      Path next = worklist.back();
-      worklist.pop_back();
-
-      Vertex_t u = next.back()->u_;
-      Vertex_t v = next.back()->v_;
-      if (p(u)) {
-        return std::make_pair(next, u);
-      } else if (p(v)) {
-        return std::make_pair(next, v);
-      } else {
-        // make new paths for work list
-        for (auto e : u->edges_) {
-          Path path = next;
-          if (0 == visited.count(e)) {
-            path.push_back(e);
-            visited.insert(e);
-            worklist.push_front(path);
-          }
+    ++s.epoch;
+    size_t head = 0, tail = 0;
+    s.seen[it->second] = s.epoch;
+    s.queue[tail++] = it->second;
+
+    while (head < tail) {
+      const uint32_t ui = s.queue[head++];
+      const Vertex_t &u = s.vertices[ui];
+      for (const Edge_t &e : u->edges_) {
+        if (!follow(e)) {
+          continue;
         }
-        for (auto e : v->edges_) {
-          Path path = next;
-          if (0 == visited.count(e)) {
-            path.push_back(e);
-            visited.insert(e);
-            worklist.push_front(path);
+        const Vertex_t &v = (e->u_ == u) ? e->v_ : e->u_;
+        auto vit = s.ids.find(v.get());
+        if (vit == s.ids.end() || s.seen[vit->second] == s.epoch) {
+          continue;
+        }
+        const uint32_t vi = vit->second;
+        s.seen[vi] = s.epoch;
+        s.parent[vi] = &e;
+        s.from[vi] = ui;
+        if (p(v)) {
+          // walk parent edges back to src
+          for (uint32_t w = vi; w != it->second; w = s.from[w]) {
+            path.push_back(*s.parent[w]);
           }
+          std::reverse(path.begin(), path.end());
+          return v;
         }
+        s.queue[tail++] = vi;
       }
     }
+    return nullptr;
+  }
 
-    return std::make_pair(Path(), nullptr);
+  /*
+    finds the shortest path from src to the nearest other vertex for which
+    UnaryPredicate(vertex) yields true
+  */
+  template <typename UnaryPredicate>
+  std::pair<Path, Vertex_t> shortest_path(const Vertex_t src,
+                                          UnaryPredicate p) {
+    Path path;
+    Vertex_t dst = shortest_path(src, p, path);
+    return std::make_pair(path, dst);
   }
 #pragma GCC diagnostic pop
 
+  /* enumerate the paths from src to dst lazily. see PathEnumerator
+   */
+  PathEnumerator enumerate_paths(const Vertex_t &src, const Vertex_t &dst,
+                                 PathEnumerator::Bound bound =
+                                     PathEnumerator::Bound()) {
+    return PathEnumerator(search_scratch().edgeIds, src, dst,
+                          std::move(bound));
+  }
+
   /*
   return all paths from src to dst
 */
   std::vector<Path> paths(const Vertex_t src, const Vertex_t dst) {
-
     std::vector<Path> ret; // the paths from src to dst
+    PathEnumerator paths = enumerate_paths(src, dst);
+    Path path;
+    while (paths.next(path)) {
+      ret.push_back(path);
+    }
+    return ret;
+  }
 
-    if (vertices_.empty()) {
-      assert(edges_.empty());
-      return ret;
+  // return the path from src to dst that has the minimum cost.
+  // if no path is found, return an empty path
+  Path min_path(const Vertex_t src, const Vertex_t dst, std::function<float(const Path &)> cost) {
+    return best_path(src, dst, cost, std::less<float>());
+  }
+
+  // return the path from src to dst that has the max cost.
+  // if no path is found, return an empty path
+  Path max_path(const Vertex_t src, const Vertex_t dst, std::function<float(const Path &)> cost) {
+    return best_path(src, dst, cost, std::greater<float>());
+  }
+
+  /* the same search as min_path(src, dst, cost) for a cost policy (see
+     namespace cost). Costs are built up as paths are extended instead of
+     recomputed for each path. Prefixes are never pruned: PathEnumerator
+     tries each edge once, from the first prefix to reach it, so dropping a
+     prefix would change which paths the search considers
+  */
+  template <typename Cost>
+  Path min_path(const Vertex_t &src, const Vertex_t &dst) {
+    return policy_path<Cost, false>(src, dst);
+  }
+
+  /* the same search as max_path(src, dst, cost) for a cost policy
+   */
+  template <typename Cost>
+  Path max_path(const Vertex_t &src, const Vertex_t &dst) {
+    return policy_path<Cost, true>(src, dst);
+  }
+
+  /* max-min Dijkstra from src.
+     fills the largest bottleneck bandwidth to each reachable vertex and the
+     edge used to reach it. if dst is provided, stop once it is settled
+  */
+  void widest_tree(const Vertex_t src, std::map<Vertex_t, double> &width,
+                   std::map<Vertex_t, Edge_t> &parent,
+                   const Vertex_t dst = nullptr) {
+    typedef std::pair<double, Vertex_t> Entry;
+    std::set<Vertex_t> done;
+    std::priority_queue<Entry> worklist;
+
+    width[src] = std::numeric_limits<double>::infinity();
+    worklist.push(std::make_pair(width[src], src));
+
+    while (!worklist.empty()) {
+      Vertex_t u = worklist.top().second;
+      worklist.pop();
+      if (!done.insert(u).second) {
+        continue; // stale entry
+      }
+      if (u == dst) {
+        break;
+      }
+
+      for (const auto &e : u->edges_) {
+        Vertex_t v = e->other_vertex(u);
+        if (done.count(v)) {
+          continue;
+        }
+        // same as CsrGraph: edges without a bandwidth model count as -1
+        const double bw = e->has_bandwidth() ? double(e->bandwidth()) : -1;
+        const double w = std::min(width[u], bw);
+        auto it = width.find(v);
+        if (it == width.end() || w > it->second) {
+          width[v] = w;
+          parent[v] = e;
+          worklist.push(std::make_pair(w, v));
+        }
+      }
     }
+  }
 
-    std::set<Edge_t> visited; // the edges we have traversed
-    std::deque<Path> worklist;
+  /* return the path from src to dst with the largest bottleneck bandwidth.
+     Same answer as max_path(src, dst, path_bandwidth), but found with a
+     max-min Dijkstra instead of enumerating every path.
+     if no path is found, return an empty path
+  */
+  Path widest_path(const Vertex_t src, const Vertex_t dst) {
+    if (!src || !dst || src == dst) {
+      return Path();
+    }
 
-    // std::cerr << "init worklist " << src->edges_.size() << "\n";
+    std::map<Vertex_t, double> width;
+    std::map<Vertex_t, Edge_t> parent;
+    widest_tree(src, width, parent, dst);
 
-    // initialize worklist
-    for (auto e : src->edges_) {
-      Path path = {e};
-      worklist.push_front(path);
-      visited.insert(e);
+    if (0 == parent.count(dst)) {
+      return Path();
+    }
+
+    // walk parent edges back to src
+    Path ret;
+    for (Vertex_t v = dst; v != src; v = ret.back()->other_vertex(v)) {
+      ret.push_back(parent[v]);
     }
+    std::reverse(ret.begin(), ret.end());
+    return ret;
+  }
+
+  /* Dijkstra on latency from src, using only edges with a latency and at
+     least minBandwidth bytes/s of bandwidth (if minBandwidth is positive).
+     fills the lowest latency to each reachable vertex and the edge used to
+     reach it. if dst is provided, stop once it is settled
+  */
+  void latency_tree(const Vertex_t src, std::map<Vertex_t, double> &latency,
+                    std::map<Vertex_t, Edge_t> &parent,
+                    const Vertex_t dst = nullptr, double minBandwidth = 0) {
+    typedef std::pair<double, Vertex_t> Entry;
+    std::set<Vertex_t> done;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>>
+        worklist;
+
+    latency[src] = 0;
+    worklist.push(std::make_pair(0.0, src));
 
     while (!worklist.empty()) {
-      // std::cerr << "worklist.size()=" << worklist.size() << "\n";
-      // std::cerr << "visited.size()=" << visited.size() << "\n";
+      Vertex_t u = worklist.top().second;
+      worklist.pop();
+      if (!done.insert(u).second) {
+        continue; // stale entry
+      }
+      if (u == dst) {
+        break;
+      }
 
-      Path next = worklist.back();
-      worklist.pop_back();
+      for (const auto &e : u->edges_) {
+        Vertex_t v = e->other_vertex(u);
+        if (done.count(v) || !e->has_latency()) {
+          continue;
+        }
+        if (minBandwidth > 0 &&
+            (!e->has_bandwidth() || e->bandwidth() < minBandwidth)) {
+          continue;
+        }
+        const double l = latency[u] + e->latency();
+        auto it = latency.find(v);
+        if (it == latency.end() || l < it->second) {
+          latency[v] = l;
+          parent[v] = e;
+          worklist.push(std::make_pair(l, v));
+        }
+      }
+    }
+  }
+
+  /* return the path from src to dst with the lowest latency.
+     if no path is found, return an empty path
+  */
+  Path lowest_latency_path(const Vertex_t src, const Vertex_t dst) {
+    return latency_path(src, dst, 0);
+  }
+
+  /* return the path from src to dst that moves bytes in the least time under
+     the alpha-beta model of path_time().
+     if no path is found, return an empty path
+  */
+  Path fastest_path(const Vertex_t src, const Vertex_t dst, double bytes) {
+    if (!src || !dst || src == dst) {
+      return Path();
+    }
 
-      if (next.back()->u_ == dst || next.back()->v_ == dst) {
-        ret.push_back(next);
-      } else {
-        // make new paths for work list
-        Vertex_t u = next.back()->u_;
-        for (auto e : u->edges_) {
-          Path path = next;
-          if (0 == visited.count(e)) {
-            path.push_back(e);
-            visited.insert(e);
-            worklist.push_back(path);
+    // The fastest path has some bottleneck b. It is also the lowest latency
+    // path among edges of at least b, so try each edge bandwidth as b
+    std::set<int64_t> bandwidths;
+    for (const auto &e : edges_) {
+      if (e->has_bandwidth() && e->bandwidth() > 0) {
+        bandwidths.insert(e->bandwidth());
+      }
+    }
+
+    Path best;
+    double bestTime = std::numeric_limits<double>::infinity();
+    for (int64_t b : bandwidths) {
+      Path p = latency_path(src, dst, double(b));
+      if (p.empty()) {
+        break; // higher bandwidths remove more edges
+      }
+      const double t = path_time(p, bytes);
+      if (t < bestTime) {
+        bestTime = t;
+        best.swap(p);
+      }
+    }
+    return best;
+  }
+
+  /* seconds to move bytes from src to dst along fastest_path(). 0 if src is
+     dst, and infinity if dst can't be reached
+  */
+  double time(const Vertex_t src, const Vertex_t dst, double bytes) {
+    if (src == dst) {
+      return 0;
+    }
+    Path p = fastest_path(src, dst, bytes);
+    return p.empty() ? std::numeric_limits<double>::infinity()
+                     : path_time(p, bytes);
+  }
+
+  /* the paths from src to dst that are not dominated in bandwidth (higher is
+     better), latency and hop count (lower is better), ordered by latency.
+     Of paths with equal objectives, only one is returned.
+
+     Multi-objective label setting: labels are settled in order of latency,
+     and a label is dropped if a settled label at its vertex, or at dst,
+     is at least as good in every objective. Edges without a latency are not
+     used, and edges without a bandwidth model count as -1
+  */
+  std::vector<ParetoPath> pareto_paths(const Vertex_t src,
+                                       const Vertex_t dst) {
+    struct Label {
+      uint32_t vertex;
+      uint32_t prefix; // label this one extends, or none
+      const Edge_t *edge;
+      double bandwidth;
+      double latency;
+      int64_t hops;
+    };
+    const uint32_t none = 0xffffffff;
+    auto dominates = [](const Label &a, const Label &b) {
+      return a.bandwidth >= b.bandwidth && a.latency <= b.latency &&
+             a.hops <= b.hops;
+    };
+
+    std::vector<ParetoPath> ret;
+    SearchScratch &s = search_scratch();
+    auto srcIt = s.ids.find(src.get());
+    auto dstIt = s.ids.find(dst.get());
+    if (srcIt == s.ids.end() || dstIt == s.ids.end() || src == dst) {
+      return ret;
+    }
+    const uint32_t d = dstIt->second;
+
+    std::vector<Label> labels;
+    std::vector<std::vector<uint32_t>> settled(s.vertices.size());
+    auto is_dominated = [&](const Label &l) {
+      for (uint32_t v : {l.vertex, d}) {
+        for (uint32_t i : settled[v]) {
+          if (dominates(labels[i], l)) {
+            return true;
           }
         }
+      }
+      return false;
+    };
 
-        Vertex_t v = next.back()->v_;
-        for (auto e : v->edges_) {
-          Path path = next;
-          if (0 == visited.count(e)) {
-            path.push_back(e);
-            visited.insert(e);
-            worklist.push_back(path);
-          }
+    // order by latency, then hops, then widest first
+    typedef std::pair<std::pair<double, int64_t>, std::pair<double, uint32_t>>
+        Entry;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>>
+        worklist;
+    auto push = [&](const Label &l) {
+      labels.push_back(l);
+      worklist.push(
+          std::make_pair(std::make_pair(l.latency, l.hops),
+                         std::make_pair(-l.bandwidth, labels.size() - 1)));
+    };
+
+    Label start;
+    start.vertex = srcIt->second;
+    start.prefix = none;
+    start.edge = nullptr;
+    start.bandwidth = std::numeric_limits<double>::infinity();
+    start.latency = 0;
+    start.hops = 0;
+    push(start);
+
+    while (!worklist.empty()) {
+      const uint32_t li = worklist.top().second.second;
+      worklist.pop();
+      if (is_dominated(labels[li])) {
+        continue;
+      }
+      settled[labels[li].vertex].push_back(li);
+      if (labels[li].vertex == d) {
+        continue; // extending a path through dst can't improve it
+      }
+
+      const Vertex_t &u = s.vertices[labels[li].vertex];
+      for (const Edge_t &e : u->edges_) {
+        const Vertex_t &v = (e->u_ == u) ? e->v_ : e->u_;
+        auto vit = s.ids.find(v.get());
+        if (vit == s.ids.end() || !e->has_latency()) {
+          continue;
+        }
+        Label next;
+        next.vertex = vit->second;
+        next.prefix = li;
+        next.edge = &e;
+        next.bandwidth =
+            std::min(labels[li].bandwidth,
+                     e->has_bandwidth() ? double(e->bandwidth()) : -1.0);
+        next.latency = labels[li].latency + e->latency();
+        next.hops = labels[li].hops + 1;
+        if (!is_dominated(next)) {
+          push(next);
         }
       }
     }
 
+    for (uint32_t li : settled[d]) {
+      ParetoPath pp;
+      pp.bandwidth = labels[li].bandwidth;
+      pp.latency = labels[li].latency;
+      pp.hops = labels[li].hops;
+      for (uint32_t l = li; labels[l].prefix != none; l = labels[l].prefix) {
+        pp.path.push_back(*labels[l].edge);
+      }
+      std::reverse(pp.path.begin(), pp.path.end());
+      ret.push_back(pp);
+    }
     return ret;
   }
 
-  // return the path from src to dst that has the minimum cost.
-  // if no path is found, return an empty path
-  Path min_path(const Vertex_t src, const Vertex_t dst, std::function<float(const Path &)> cost) {
-    std::vector<Path> allPaths = paths(src, dst);
-    if (allPaths.empty()) {
-      return Path();
+  /* bottleneck bandwidth and hop count between every pair of vertices.
+     computed on first use and reused until the graph version changes
+  */
+  const PairMatrix &all_pairs() {
+    if (pairs_.version == version_) {
+      return pairs_;
     }
-    auto path_cmp = [&](const Path &a, const Path &b) {
-      return cost(a) < cost(b);
-    };
-    auto it = std::min_element(allPaths.begin(), allPaths.end(), path_cmp);
-    assert(it != allPaths.end());
-    return *it;
-  }
 
-  // return the path from src to dst that has the max cost.
-  // if no path is found, return an empty path
-  Path max_path(const Vertex_t src, const Vertex_t dst, std::function<float(const Path &)> cost) {
-    std::vector<Path> allPaths = paths(src, dst);
-    if (allPaths.empty()) {
-      return Path();
+    const int64_t n = vertices_.size();
+    pairs_.vertices.assign(vertices_.begin(), vertices_.end());
+    pairs_.index.clear();
+    for (int64_t i = 0; i < n; ++i) {
+      pairs_.index[pairs_.vertices[i]] = i;
     }
-    auto path_cmp = [&](const Path &a, const Path &b) {
-      return cost(a) < cost(b);
-    };
-    auto it = std::max_element(allPaths.begin(), allPaths.end(), path_cmp);
-    assert(it != allPaths.end());
-    return *it;
+    pairs_.bandwidth = Mat2D<double>(n, n, -1);
+    pairs_.hops = Mat2D<int64_t>(n, n, -1);
+
+    for (int64_t i = 0; i < n; ++i) {
+      const Vertex_t &src = pairs_.vertices[i];
+
+      std::map<Vertex_t, double> width;
+      std::map<Vertex_t, Edge_t> parent;
+      widest_tree(src, width, parent);
+      for (const auto &kv : parent) {
+        pairs_.bandwidth(i, pairs_.index[kv.first]) = width[kv.first];
+      }
+
+      // breadth-first search for hop counts
+      pairs_.hops(i, i) = 0;
+      std::deque<Vertex_t> worklist = {src};
+      while (!worklist.empty()) {
+        Vertex_t u = worklist.front();
+        worklist.pop_front();
+        const int64_t d = pairs_.hops(i, pairs_.index[u]);
+        for (const auto &e : u->edges_) {
+          const Vertex_t v = e->other_vertex(u);
+          const int64_t j = pairs_.index[v];
+          if (pairs_.hops(i, j) < 0) {
+            pairs_.hops(i, j) = d + 1;
+            worklist.push_back(v);
+          }
+        }
+      }
+    }
+
+    pairs_.version = version_;
+    return pairs_;
   }
 
   std::string dot_str() const {
@@ -824,8 +1596,234 @@ public:
   }
 
 private:
+  /* dense vertex and edge ids, and per-vertex breadth-first search state
+     indexed by vertex id. seen[i] == epoch marks vertex i visited in the
+     current search, so the buffers never need to be cleared
+  */
+  struct SearchScratch {
+    uint64_t version;
+    uint64_t epoch;
+    std::unordered_map<const Vertex *, uint32_t> ids;
+    PathEnumerator::EdgeIds edgeIds;
+    std::vector<Vertex_t> vertices;
+    std::vector<uint64_t> seen;
+    std::vector<const Edge_t *> parent; // edge the vertex was reached by
+    std::vector<uint32_t> from;         // vertex the parent edge came from
+    std::vector<uint32_t> queue;
+
+    SearchScratch() : version(0), epoch(0) {}
+  };
+
+  /* the path from src to dst that cost orders first by cmp. each path's cost
+     is computed once and only the best path is kept
+  */
+  template <typename Compare>
+  Path best_path(const Vertex_t &src, const Vertex_t &dst,
+                 const std::function<float(const Path &)> &cost, Compare cmp) {
+    Path best, path;
+    float bestCost = 0;
+    PathEnumerator paths = enumerate_paths(src, dst);
+    while (paths.next(path)) {
+      const float c = cost(path);
+      if (best.empty() || cmp(c, bestCost)) {
+        best.swap(path);
+        bestCost = c;
+      }
+    }
+    return best;
+  }
+
+  /* PathEnumerator's search with a cost per partial path
+   */
+  template <typename Cost, bool Maximize>
+  Path policy_path(const Vertex_t &src, const Vertex_t &dst) {
+    typedef typename Cost::value_type value_type;
+    struct Node {
+      const Edge_t *edge;
+      uint32_t prefix;
+      value_type cost;
+    };
+    const uint32_t none = 0xffffffff;
+    auto better = [](const value_type &a, const value_type &b) {
+      return Maximize ? Cost::less(b, a) : Cost::less(a, b);
+    };
+
+    const PathEnumerator::EdgeIds &ids = search_scratch().edgeIds;
+    std::vector<char> visited(ids.size(), 0);
+    std::vector<Node> arena;
+    std::vector<uint32_t> worklist;
+    uint32_t best = none;
+
+    auto push = [&](uint32_t prefix, const Edge_t &e) {
+      auto it = ids.find(e.get());
+      if (it == ids.end() || visited[it->second]) {
+        return;
+      }
+      visited[it->second] = 1;
+      Node n;
+      n.edge = &e;
+      n.prefix = prefix;
+      n.cost = Cost::combine(
+          prefix == none ? Cost::identity() : arena[prefix].cost,
+          Cost::edge(e));
+      arena.push_back(n);
+      worklist.push_back(arena.size() - 1);
+    };
+
+    if (src) {
+      for (auto it = src->edges_.rbegin(); it != src->edges_.rend(); ++it) {
+        push(none, *it);
+      }
+    }
+
+    while (!worklist.empty()) {
+      const uint32_t n = worklist.back();
+      worklist.pop_back();
+
+      const Edge_t &last = *arena[n].edge;
+      if (last->u_ == dst || last->v_ == dst) {
+        if (best == none || better(arena[n].cost, arena[best].cost)) {
+          best = n;
+        }
+        continue;
+      }
+      for (const Edge_t &e : last->u_->edges_) {
+        push(n, e);
+      }
+      for (const Edge_t &e : last->v_->edges_) {
+        push(n, e);
+      }
+    }
+
+    Path ret;
+    for (uint32_t n = best; n != none; n = arena[n].prefix) {
+      ret.push_back(*arena[n].edge);
+    }
+    std::reverse(ret.begin(), ret.end());
+    return ret;
+  }
+
+  /* lowest-latency path over edges of at least minBandwidth
+   */
+  Path latency_path(const Vertex_t &src, const Vertex_t &dst,
+                    double minBandwidth) {
+    if (!src || !dst || src == dst) {
+      return Path();
+    }
+
+    std::map<Vertex_t, double> latency;
+    std::map<Vertex_t, Edge_t> parent;
+    latency_tree(src, latency, parent, dst, minBandwidth);
+
+    if (0 == parent.count(dst)) {
+      return Path();
+    }
+
+    // walk parent edges back to src
+    Path ret;
+    for (Vertex_t v = dst; v != src; v = ret.back()->other_vertex(v)) {
+      ret.push_back(parent[v]);
+    }
+    std::reverse(ret.begin(), ret.end());
+    return ret;
+  }
+
+  /* search_, rebuilt if the graph changed since it was last used
+   */
+  SearchScratch &search_scratch() {
+    if (search_.version != version_) {
+      const size_t n = vertices_.size();
+      search_.ids.clear();
+      search_.vertices.assign(vertices_.begin(), vertices_.end());
+      for (uint32_t i = 0; i < n; ++i) {
+        search_.ids[search_.vertices[i].get()] = i;
+      }
+      search_.edgeIds.clear();
+      uint32_t edgeId = 0;
+      for (const auto &e : edges_) {
+        search_.edgeIds[e.get()] = edgeId++;
+      }
+      search_.seen.assign(n, 0);
+      search_.parent.assign(n, nullptr);
+      search_.from.assign(n, 0);
+      search_.queue.resize(n);
+      search_.epoch = 0;
+      search_.version = version_;
+    }
+    return search_;
+  }
+
+  static uint64_t bus_key(PciAddress::domain_type dom, unsigned bus) {
+    return uint64_t(dom) << 8 | bus;
+  }
+
+  static int bus_span(const Vertex_t &br) {
+    return br->data_.bridge_.subordinateBus.bus_ -
+           br->data_.bridge_.secondaryBus.bus_;
+  }
+
+  /* claim bus for br if no narrower bridge already covers it
+   */
+  void claim_bus(const Vertex_t &br, unsigned bus) {
+    Vertex_t &owner = busIndex_[bus_key(br->data_.bridge_.domain.domain_, bus)];
+    if (!owner || bus_span(br) < bus_span(owner) ||
+        (bus_span(br) == bus_span(owner) &&
+         br->data_.bridge_.secondaryBus.bus_ >
+             owner->data_.bridge_.secondaryBus.bus_)) {
+      owner = br;
+    }
+  }
+
+  void index_pci(const Vertex_t &v) {
+    const PciAddress *addr = v->pci_address();
+    if (addr) {
+      pciIndex_.insert(std::make_pair(addr->packed(), v));
+    }
+    if (v->type_ == Vertex::Type::Bridge) {
+      for (unsigned bus = v->data_.bridge_.secondaryBus.bus_;
+           bus <= v->data_.bridge_.subordinateBus.bus_; ++bus) {
+        claim_bus(v, bus);
+      }
+    }
+  }
+
+  void unindex_pci(const Vertex_t &v) {
+    const PciAddress *addr = v->pci_address();
+    if (addr) {
+      auto it = pciIndex_.find(addr->packed());
+      if (it != pciIndex_.end() && it->second == v) {
+        pciIndex_.erase(it);
+      }
+    }
+    if (v->type_ == Vertex::Type::Bridge) {
+      // release the buses this bridge owned, and let the remaining bridges
+      // in the domain claim them again
+      const auto dom = v->data_.bridge_.domain.domain_;
+      for (unsigned bus = v->data_.bridge_.secondaryBus.bus_;
+           bus <= v->data_.bridge_.subordinateBus.bus_; ++bus) {
+        auto it = busIndex_.find(bus_key(dom, bus));
+        if (it != busIndex_.end() && it->second == v) {
+          busIndex_.erase(it);
+          for (const auto &br : vertices_) {
+            if (br != v && br->type_ == Vertex::Type::Bridge &&
+                br->data_.bridge_.domain.domain_ == dom &&
+                br->data_.bridge_.secondaryBus.bus_ <= bus &&
+                br->data_.bridge_.subordinateBus.bus_ >= bus) {
+              claim_bus(br, bus);
+            }
+          }
+        }
+      }
+    }
+  }
+
   std::set<std::shared_ptr<Vertex>> vertices_;
   std::set<std::shared_ptr<Edge>> edges_;
+  uint64_t version_;
+  PairMatrix pairs_;
+  SearchScratch search_;
+  std::unordered_map<uint64_t, Vertex_t> pciIndex_; // PciAddress::packed()
+  std::unordered_map<uint64_t, Vertex_t> busIndex_; // bus_key() -> bridge
 }; // namespace nvml
 
 } // namespace hwgraph
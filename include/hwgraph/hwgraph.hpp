@@ -1,7 +1,10 @@
 #pragma once
 
+#include "csr.hpp"
 #include "graph.hpp"
 #include "hwloc.hpp"
+#include "nvml_backend.hpp"
+#include "snapshot.hpp"
 #if HWGRAPH_USE_NVML == 1
 #include "nvml.hpp"
 #endif
@@ -38,7 +41,7 @@ inline bool operator&&(DiscoveryMethod a, DiscoveryMethod b) {
 
 /* Return available methods (to be passed to make_graph)
 */
-DiscoveryMethod available_methods() {
+inline DiscoveryMethod available_methods() {
   DiscoveryMethod ret = DiscoveryMethod::None;
 #if HWGRAPH_USE_NVML == 1
   ret |= DiscoveryMethod::Nvml;
@@ -49,25 +52,88 @@ DiscoveryMethod available_methods() {
   return ret;
 }
 
-/* Use the provided methods to build a hardware graph
+/* Use the provided methods to build a hardware graph.
+   hwloc discovery uses topo instead of loading its own topology, and NVML
+   discovery asks nvml instead of the NVML library. With a
+   nvml::ReplayBackend this works on machines without GPUs or NVML
 */
-Graph make_graph(const DiscoveryMethod &method) {
+inline Graph make_graph(const DiscoveryMethod &method,
+                        const hwloc::Topology &topo, nvml::Backend &nvml) {
   Graph g;
 
   if (method && DiscoveryMethod::Hwloc) {
-    hwloc::add_packages(g);
+    hwloc::add_packages(g, topo);
+    hwloc::add_numa_nodes(g, topo);
+    hwloc::add_cores(g, topo);
+    hwloc::add_pci(g, topo);
   }
-  if (method && DiscoveryMethod::Hwloc) {
-    hwloc::add_pci(g);
+
+  if (method && DiscoveryMethod::Nvml) {
+    nvml::add_gpus(g, nvml);
+    nvml::add_nvlinks(g, nvml);
   }
 
+  return g;
+}
+
+/* Use the provided methods to build a hardware graph.
+   hwloc discovery uses topo instead of loading its own topology
+*/
+inline Graph make_graph(const DiscoveryMethod &method,
+                        const hwloc::Topology &topo) {
 #if HWGRAPH_USE_NVML == 1
   if (method && DiscoveryMethod::Nvml) {
-    nvml::add_gpus(g);
-    nvml::add_nvlinks(g);
+    nvml::LiveBackend nvml; // one nvmlInit() for both passes
+    return make_graph(method, topo, nvml);
   }
 #endif
+  nvml::ReplayBackend none((nvml::Recording()));
+  return make_graph(method & DiscoveryMethod::Hwloc, topo, none);
+}
+
+/* Use the provided methods to build a hardware graph
+*/
+inline Graph make_graph(const DiscoveryMethod &method) {
+  if (method && DiscoveryMethod::Hwloc) {
+    hwloc::Topology topo;
+    return make_graph(method, topo);
+  } else {
+    return make_graph(method, hwloc::Topology(nullptr));
+  }
+}
 
+/* Use the provided methods to build a hardware graph from an hwloc topology
+   the caller has already loaded
+*/
+inline Graph make_graph(const DiscoveryMethod &method,
+                        hwloc_topology_t topology) {
+  return make_graph(method, hwloc::Topology(topology));
+}
+
+/* Like make_graph(method), but reuse the snapshot at path if it was written
+   during this boot on the same hardware with the same methods. Otherwise
+   discover the graph and replace the snapshot. The snapshot is only a
+   cache: if it can't be written, the discovered graph is still returned
+*/
+inline Graph make_graph_cached(const DiscoveryMethod &method,
+                               const std::string &path) {
+  const SnapshotKey key = SnapshotKey::current();
+  const uint32_t methods = static_cast<int>(method);
+  try {
+    Snapshot snap(path);
+    if (snap.matches(key) && snap.methods() == methods) {
+      return snap.graph();
+    }
+  } catch (const std::runtime_error &) {
+    // missing, incompatible or corrupt snapshot
+  }
+
+  Graph g = make_graph(method);
+  try {
+    write_snapshot(g, path, key, methods);
+  } catch (const std::runtime_error &) {
+    // unwritable cache directory, full disk, ...
+  }
   return g;
 }
 
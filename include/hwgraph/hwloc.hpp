@@ -1,5 +1,10 @@
 #pragma once
 
+#include <cstring>
+#include <map>
+#include <stdexcept>
+#include <string>
+
 #include <hwloc.h>
 
 #include "graph.hpp"
@@ -7,12 +12,160 @@
 namespace hwgraph {
 namespace hwloc {
 
-inline void add_packages(hwgraph::Graph &graph) {
-  hwloc_topology_t topology;
+/* A loaded hwloc topology shared by all hwloc discovery passes.
+
+   The default constructor loads the topology once, keeping only the object
+   types hwgraph uses. A topology the caller already loaded can be borrowed
+   instead; it must include I/O objects for add_pci() to find anything, and
+   it is not destroyed with this object.
+*/
+class Topology {
+public:
+  Topology() : owned_(true) {
+    hwloc_topology_init(&topology_);
+    configure(topology_);
+    hwloc_topology_load(topology_);
+  }
+
+  explicit Topology(hwloc_topology_t topology)
+      : topology_(topology), owned_(false) {}
+
+  ~Topology() {
+    if (owned_) {
+      hwloc_topology_destroy(topology_);
+    }
+  }
+
+  Topology(Topology &&other) noexcept
+      : topology_(other.topology_), owned_(other.owned_) {
+    other.owned_ = false;
+  }
+  Topology(const Topology &other) = delete;
+  Topology &operator=(const Topology &other) = delete;
+
+  /* load a topology exported with lstopo or hwloc_topology_export_xml()
+   */
+  static Topology from_xml(const std::string &path) {
+    hwloc_topology_t topology;
+    hwloc_topology_init(&topology);
+    configure(topology);
+    if (hwloc_topology_set_xml(topology, path.c_str()) ||
+        hwloc_topology_load(topology)) {
+      hwloc_topology_destroy(topology);
+      throw std::runtime_error("couldn't load hwloc XML from " + path);
+    }
+    return Topology(topology, true);
+  }
+
+  /* load a topology from XML already in memory
+   */
+  static Topology from_xml_buffer(const std::string &xml) {
+    hwloc_topology_t topology;
+    hwloc_topology_init(&topology);
+    configure(topology);
+    if (hwloc_topology_set_xmlbuffer(topology, xml.c_str(),
+                                     int(xml.size() + 1)) ||
+        hwloc_topology_load(topology)) {
+      hwloc_topology_destroy(topology);
+      throw std::runtime_error("couldn't load hwloc XML buffer");
+    }
+    return Topology(topology, true);
+  }
 
-  hwloc_topology_init(&topology);
-  hwloc_topology_set_flags(topology, HWLOC_TOPOLOGY_FLAG_WHOLE_SYSTEM);
-  hwloc_topology_load(topology);
+  /* load a synthetic topology, e.g. "pack:2 core:8 pu:2".
+     synthetic topologies have no I/O objects
+  */
+  static Topology from_synthetic(const std::string &description) {
+    hwloc_topology_t topology;
+    hwloc_topology_init(&topology);
+    configure(topology);
+    if (hwloc_topology_set_synthetic(topology, description.c_str()) ||
+        hwloc_topology_load(topology)) {
+      hwloc_topology_destroy(topology);
+      throw std::runtime_error("couldn't load synthetic hwloc topology " +
+                               description);
+    }
+    return Topology(topology, true);
+  }
+
+  hwloc_topology_t get() const noexcept { return topology_; }
+
+  /* request the whole system with PCI bridges and devices, and skip the
+     object types discovery does not look at. Of the caches, only L3 is kept
+  */
+  static void configure(hwloc_topology_t topology) {
+#if HWLOC_API_VERSION >= 0x00020000
+    hwloc_topology_set_flags(topology, HWLOC_TOPOLOGY_FLAG_WHOLE_SYSTEM);
+    hwloc_topology_set_io_types_filter(topology, HWLOC_TYPE_FILTER_KEEP_ALL);
+    hwloc_topology_set_cache_types_filter(topology,
+                                          HWLOC_TYPE_FILTER_KEEP_NONE);
+    hwloc_topology_set_icache_types_filter(topology,
+                                           HWLOC_TYPE_FILTER_KEEP_NONE);
+    hwloc_topology_set_type_filter(topology, HWLOC_OBJ_L3CACHE,
+                                   HWLOC_TYPE_FILTER_KEEP_ALL);
+    hwloc_topology_set_type_filter(topology, HWLOC_OBJ_MISC,
+                                   HWLOC_TYPE_FILTER_KEEP_NONE);
+#else
+    hwloc_topology_set_flags(topology, HWLOC_TOPOLOGY_FLAG_WHOLE_SYSTEM |
+                                           HWLOC_TOPOLOGY_FLAG_IO_BRIDGES |
+                                           HWLOC_TOPOLOGY_FLAG_WHOLE_IO);
+    hwloc_topology_ignore_type(topology, HWLOC_OBJ_MISC);
+#endif
+  }
+
+private:
+  Topology(hwloc_topology_t topology, bool owned)
+      : topology_(topology), owned_(owned) {}
+
+  hwloc_topology_t topology_;
+  bool owned_;
+};
+
+/* The kind of package vertex to create for topology.
+   Uses the architecture the topology was discovered on, so that XML exported
+   from another machine works, and falls back to the one hwgraph was built for
+*/
+inline Vertex::Type package_type(hwloc_topology_t topology) {
+  const char *arch = hwloc_obj_get_info_by_name(
+      hwloc_get_root_obj(topology), "Architecture");
+  if (arch) {
+    const std::string a(arch);
+    if (a == "x86_64" || a == "i686" || a == "i386") {
+      return Vertex::Type::Intel;
+    } else if (a.find("ppc") == 0) {
+      return Vertex::Type::Ppc;
+    }
+    return Vertex::Type::Unknown;
+  }
+#ifdef __x86_64__
+  return Vertex::Type::Intel;
+#elif __PPC__
+  return Vertex::Type::Ppc;
+#else
+  return Vertex::Type::Unknown;
+#endif
+}
+
+/* the CPUs and NUMA nodes of an hwloc object
+ */
+inline Locality locality(const hwloc_obj_t obj) {
+  Locality l;
+  std::memset(&l, 0, sizeof(l));
+  unsigned i;
+  if (obj->cpuset) {
+    hwloc_bitmap_foreach_begin(i, obj->cpuset) { l.add_cpu(i); }
+    hwloc_bitmap_foreach_end();
+  }
+  if (obj->nodeset) {
+    hwloc_bitmap_foreach_begin(i, obj->nodeset) { l.add_node(i); }
+    hwloc_bitmap_foreach_end();
+  }
+  return l;
+}
+
+inline void add_packages(hwgraph::Graph &graph, const Topology &topo) {
+  hwloc_topology_t topology = topo.get();
+  const Vertex::Type pkgType = package_type(topology);
 
   // Add packages to system
 
@@ -27,17 +180,17 @@ inline void add_packages(hwgraph::Graph &graph) {
     for (unsigned i = 0; i < numPackages; ++i) {
       hwloc_obj_t obj = hwloc_get_obj_by_depth(topology, depth, i);
 
-      Vertex *v = new Vertex();
+      Vertex *v = new Vertex(pkgType);
 
-#ifdef __x86_64__
-      v->type_ = Vertex::Type::Intel;
-      v->data_.intel.idx = i;
-      v->name_ = obj->name ? obj->name : "anonymous intel";
-#elif __PPC__
-      v->type_ = Vertex::Type::Ppc;
-      v->data_.ppc_.idx = i;
-      v->name_ = obj->name ? obj->name : "anonymous PPC";
-#endif
+      if (pkgType == Vertex::Type::Intel) {
+        v->data_.intel.idx = i;
+        v->data_.intel.locality = locality(obj);
+        v->name_ = obj->name ? obj->name : "anonymous intel";
+      } else if (pkgType == Vertex::Type::Ppc) {
+        v->data_.ppc_.idx = i;
+        v->data_.ppc_.locality = locality(obj);
+        v->name_ = obj->name ? obj->name : "anonymous PPC";
+      }
 
       // section 23.13 p. 266
       for (unsigned j = 0; j < obj->infos_count; ++j) {
@@ -46,40 +199,35 @@ inline void add_packages(hwgraph::Graph &graph) {
         // obj->infos[j].value,
         //         std::atoi(obj->infos[j].value));
 
-// Section 9.2 (p.37)
-#ifdef __x86_64__
-
-        if (std::string("CPUModel") == obj->infos[j].name) {
-          v->name_ = obj->infos[j].value;
-          std::strncpy(v->data_.intel.model, obj->infos[j].value,
-                       hwgraph::MAX_STR);
-        } else if (std::string("CPUVendor") == obj->infos[j].name) {
-          std::strncpy(v->data_.intel.vendor, obj->infos[j].value,
-                       hwgraph::MAX_STR);
-        } else if (std::string("CPUModelNumber") == obj->infos[j].name) {
-          v->data_.intel.modelNumber = std::atoi(obj->infos[j].value);
-        } else if (std::string("CPUFamilyNumber") == obj->infos[j].name) {
-          v->data_.intel.familyNumber = std::atoi(obj->infos[j].value);
-        } else if (std::string("CPUStepping") == obj->infos[j].name) {
-          v->data_.intel.stepping = std::atoi(obj->infos[j].value);
-        }
-#endif
-
-#ifdef __PPC__
-        if (std::string("CPUModel") == obj->infos[j].name) {
-          v->name_ = obj->infos[j].value;
-          std::strncpy(v->data_.ppc_.model, obj->infos[j].value, MAX_STR);
-        } else if (std::string("CPURevision") == obj->infos[j].name) {
-          v->data_.ppc_.revision = std::atoi(obj->infos[j].value);
+        // Section 9.2 (p.37)
+        if (pkgType == Vertex::Type::Intel) {
+          if (std::string("CPUModel") == obj->infos[j].name) {
+            v->name_ = obj->infos[j].value;
+            std::strncpy(v->data_.intel.model, obj->infos[j].value,
+                         hwgraph::MAX_STR);
+          } else if (std::string("CPUVendor") == obj->infos[j].name) {
+            std::strncpy(v->data_.intel.vendor, obj->infos[j].value,
+                         hwgraph::MAX_STR);
+          } else if (std::string("CPUModelNumber") == obj->infos[j].name) {
+            v->data_.intel.modelNumber = std::atoi(obj->infos[j].value);
+          } else if (std::string("CPUFamilyNumber") == obj->infos[j].name) {
+            v->data_.intel.familyNumber = std::atoi(obj->infos[j].value);
+          } else if (std::string("CPUStepping") == obj->infos[j].name) {
+            v->data_.intel.stepping = std::atoi(obj->infos[j].value);
+          }
+        } else if (pkgType == Vertex::Type::Ppc) {
+          if (std::string("CPUModel") == obj->infos[j].name) {
+            v->name_ = obj->infos[j].value;
+            std::strncpy(v->data_.ppc_.model, obj->infos[j].value, MAX_STR);
+          } else if (std::string("CPURevision") == obj->infos[j].name) {
+            v->data_.ppc_.revision = std::atoi(obj->infos[j].value);
+          }
         }
-#endif
       }
       graph.take_vertex(v);
     }
 
-// https://en.wikichip.org/wiki/intel/cpuid
-#ifdef __PPC__
-
+    // https://en.wikichip.org/wiki/intel/cpuid
     for (auto i : graph.vertices<Vertex::Type::Ppc>()) {
       for (auto j : graph.vertices<Vertex::Type::Ppc>()) {
         if (i != j) {
@@ -88,11 +236,7 @@ inline void add_packages(hwgraph::Graph &graph) {
       }
     }
 
-#endif
-
-#ifdef __x86_64__
     // consider https://github.com/NVIDIA/nccl/blob/master/src/graph/topo.cc
-
     for (auto i : graph.vertices<Vertex::Type::Intel>()) {
       for (auto j : graph.vertices<Vertex::Type::Intel>()) {
         if (i != j) {
@@ -109,16 +253,159 @@ inline void add_packages(hwgraph::Graph &graph) {
         }
       }
     }
+  }
+}
+
+inline void add_packages(hwgraph::Graph &graph) {
+  Topology topo;
+  add_packages(graph, topo);
+}
+
+/* the package vertex for the package obj is in, or nullptr
+ */
+inline Vertex_t package_of(hwgraph::Graph &graph, hwloc_topology_t topology,
+                           hwloc_obj_t obj) {
+  hwloc_obj_t pkg =
+      hwloc_get_ancestor_obj_by_type(topology, HWLOC_OBJ_PACKAGE, obj);
+  return pkg ? graph.get_package(pkg->logical_index) : nullptr;
+}
+
+/* A Memory edge from the CPUs of pkg to the memory of node, with the
+   bandwidth and latency hwloc's memory attributes report for them, if any
+*/
+inline Edge_t memory_edge(hwloc_topology_t topology, hwloc_obj_t pkg,
+                          hwloc_obj_t node) {
+  int64_t bw = 0;
+  double latency = -1;
+#if HWLOC_API_VERSION >= 0x00020300
+  struct hwloc_location initiator;
+  initiator.type = HWLOC_LOCATION_TYPE_CPUSET;
+  initiator.location.cpuset = pkg->cpuset;
+  hwloc_uint64_t value;
+  if (0 == hwloc_memattr_get_value(topology, HWLOC_MEMATTR_ID_BANDWIDTH,
+                                   node, &initiator, 0, &value)) {
+    bw = int64_t(value) << 20; // MiB/s
+  }
+  if (0 == hwloc_memattr_get_value(topology, HWLOC_MEMATTR_ID_LATENCY, node,
+                                   &initiator, 0, &value)) {
+    latency = double(value) * 1e-9; // ns
+  }
+#else
+  (void)topology;
+  (void)pkg;
+  (void)node;
+#endif
+  Edge_t e = Edge::new_memory(bw);
+  e->latency_ = latency;
+  return e;
+}
+
+/* Add a vertex for each NUMA node, joined by a Memory edge to the package it
+   is in. A node outside any package, such as one memory controller shared
+   by the whole machine, is joined to every package with CPUs local to it.
+   Call after add_packages()
+*/
+inline void add_numa_nodes(hwgraph::Graph &graph, const Topology &topo) {
+  hwloc_topology_t topology = topo.get();
+  const int numNodes = hwloc_get_nbobjs_by_type(topology, HWLOC_OBJ_NUMANODE);
+  const int numPackages =
+      hwloc_get_nbobjs_by_type(topology, HWLOC_OBJ_PACKAGE);
+  for (int i = 0; i < numNodes; ++i) {
+    hwloc_obj_t obj = hwloc_get_obj_by_type(topology, HWLOC_OBJ_NUMANODE, i);
+    auto v = std::make_shared<Vertex>(Vertex::Type::NumaNode);
+    v->name_ = "NUMANode P#" + std::to_string(obj->os_index);
+    v->data_.numaNode.idx = obj->os_index;
+#if HWLOC_API_VERSION >= 0x00020000
+    v->data_.numaNode.memory = obj->attr->numanode.local_memory;
+#else
+    v->data_.numaNode.memory = obj->memory.local_memory;
 #endif
+    v->data_.numaNode.locality = locality(obj);
+    graph.insert_vertex(v);
 
-    hwloc_topology_destroy(topology);
+    if (hwloc_obj_t pkg = hwloc_get_ancestor_obj_by_type(
+            topology, HWLOC_OBJ_PACKAGE, obj)) {
+      if (Vertex_t p = graph.get_package(pkg->logical_index)) {
+        graph.join(p, v, memory_edge(topology, pkg, obj));
+      }
+      continue;
+    }
+    for (int j = 0; j < numPackages; ++j) {
+      hwloc_obj_t pkg = hwloc_get_obj_by_type(topology, HWLOC_OBJ_PACKAGE, j);
+      Vertex_t p = graph.get_package(j);
+      if (p && obj->cpuset &&
+          hwloc_bitmap_intersects(pkg->cpuset, obj->cpuset)) {
+        graph.join(p, v, memory_edge(topology, pkg, obj));
+      }
+    }
+  }
+}
+
+/* true if obj is an L3 data or unified cache
+ */
+inline bool is_l3(const hwloc_obj_t obj) {
+#if HWLOC_API_VERSION >= 0x00020000
+  return obj->type == HWLOC_OBJ_L3CACHE;
+#else
+  return obj->type == HWLOC_OBJ_CACHE && obj->attr->cache.depth == 3 &&
+         obj->attr->cache.type != HWLOC_OBJ_CACHE_INSTRUCTION;
+#endif
+}
+
+/* Add a vertex for each core, joined by an Onchip edge to the L3 it shares,
+   and a vertex for each such L3, joined to its package. A core without an
+   L3 is joined to its package directly. Call after add_packages()
+*/
+inline void add_cores(hwgraph::Graph &graph, const Topology &topo) {
+  hwloc_topology_t topology = topo.get();
+  std::map<hwloc_obj_t, Vertex_t> l3s;
+  const int numCores = hwloc_get_nbobjs_by_type(topology, HWLOC_OBJ_CORE);
+  for (int i = 0; i < numCores; ++i) {
+    hwloc_obj_t obj = hwloc_get_obj_by_type(topology, HWLOC_OBJ_CORE, i);
+    auto v = std::make_shared<Vertex>(Vertex::Type::Core);
+    v->name_ = "Core L#" + std::to_string(obj->logical_index);
+    v->data_.core.idx = obj->logical_index;
+    v->data_.core.pkgIdx = obj->logical_index;
+    v->data_.core.locality = locality(obj);
+    hwloc_obj_t pkg =
+        hwloc_get_ancestor_obj_by_type(topology, HWLOC_OBJ_PACKAGE, obj);
+    if (pkg) {
+      // cores are numbered in tree order, so a package's are contiguous
+      hwloc_obj_t first = hwloc_get_next_obj_inside_cpuset_by_type(
+          topology, pkg->cpuset, HWLOC_OBJ_CORE, nullptr);
+      assert(first);
+      v->data_.core.pkgIdx = obj->logical_index - first->logical_index;
+    }
+    graph.insert_vertex(v);
+
+    hwloc_obj_t l3 = obj->parent;
+    while (l3 && !is_l3(l3)) {
+      l3 = l3->parent;
+    }
+    Vertex_t up = package_of(graph, topology, obj);
+    if (l3) {
+      Vertex_t &c = l3s[l3];
+      if (!c) {
+        c = std::make_shared<Vertex>(Vertex::Type::L3);
+        c->name_ = "L3 L#" + std::to_string(l3->logical_index);
+        c->data_.l3.idx = l3->logical_index;
+        c->data_.l3.size = l3->attr->cache.size;
+        c->data_.l3.locality = locality(l3);
+        graph.insert_vertex(c);
+        if (up) {
+          graph.join(up, c, Edge::new_onchip());
+        }
+      }
+      up = c;
+    }
+    if (up) {
+      graph.join(up, v, Edge::new_onchip());
+    }
   }
 }
 
 inline bool is_hostbridge(const hwloc_obj_t obj) {
-  auto result = hwloc_compare_types(obj->type, HWLOC_OBJ_BRIDGE);
-  assert(result != HWLOC_TYPE_UNORDERED);
-  if (result == 0) { // is a bridge
+  if (obj->type == HWLOC_OBJ_BRIDGE) {
     auto upstream = obj->attr->bridge.upstream_type;
     auto downstream = obj->attr->bridge.downstream_type;
     return (upstream == HWLOC_OBJ_BRIDGE_HOST) &&
@@ -129,9 +416,7 @@ inline bool is_hostbridge(const hwloc_obj_t obj) {
 }
 
 inline bool is_pcibridge(const hwloc_obj_t obj) {
-  auto result = hwloc_compare_types(obj->type, HWLOC_OBJ_BRIDGE);
-  assert(result != HWLOC_TYPE_UNORDERED);
-  if (result == 0) { // is a bridge
+  if (obj->type == HWLOC_OBJ_BRIDGE) {
     auto upstream = obj->attr->bridge.upstream_type;
     return (upstream == HWLOC_OBJ_BRIDGE_PCI); // is a pci->something bridge
   } else {
@@ -198,8 +483,7 @@ inline void visit_pci_device(hwgraph::Graph &graph, const hwloc_obj_t obj) {
     // Link to parent
     const auto parent = obj->parent;
     assert(parent);
-    assert(0 == hwloc_compare_types(parent->type, HWLOC_OBJ_BRIDGE) &&
-           "Pci parent should be a bridge");
+    assert(parent->type == HWLOC_OBJ_BRIDGE && "Pci parent should be a bridge");
 
     const auto &parentBridge = graph.get_bridge_for_address(objAddress);
     std::cerr << "visit_pci_device(): Parent is " << parentBridge->str()
@@ -211,6 +495,68 @@ inline void visit_pci_device(hwgraph::Graph &graph, const hwloc_obj_t obj) {
   }
 }
 
+/* the vertex type for a PCI device with OS device obj, or Unknown if obj
+   does not say what the device is for
+*/
+inline Vertex::Type os_device_type(const hwloc_obj_t obj) {
+#if HWLOC_API_VERSION >= 0x00030000
+  // a bitmask in hwloc 3, e.g. COPROC | GPU for cuda0
+  const hwloc_obj_osdev_types_t types = obj->attr->osdev.types;
+  if (types & (HWLOC_OBJ_OSDEV_NETWORK | HWLOC_OBJ_OSDEV_OPENFABRICS)) {
+    return Vertex::Type::Nic;
+  } else if (types & HWLOC_OBJ_OSDEV_STORAGE) {
+    return Vertex::Type::Storage;
+  } else if (types & HWLOC_OBJ_OSDEV_COPROC) {
+    return Vertex::Type::Coprocessor;
+  }
+  return Vertex::Type::Unknown; // display devices and DMA engines
+#else
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wswitch-enum"
+  switch (obj->attr->osdev.type) {
+  case HWLOC_OBJ_OSDEV_NETWORK:     // e.g. eth0, ib0
+  case HWLOC_OBJ_OSDEV_OPENFABRICS: // e.g. mlx5_0, hfi1_0
+    return Vertex::Type::Nic;
+  case HWLOC_OBJ_OSDEV_BLOCK: // e.g. nvme0n1, sda
+    return Vertex::Type::Storage;
+  case HWLOC_OBJ_OSDEV_COPROC: // e.g. cuda0, opencl0d0, mic0
+    return Vertex::Type::Coprocessor;
+  default: // display devices and DMA engines
+    return Vertex::Type::Unknown;
+  }
+#pragma GCC diagnostic pop
+#endif
+}
+
+/* Give the PCI device above OS device obj the type the OS device implies,
+   and record the OS device's name on it. The first OS device that implies
+   a type decides it
+*/
+inline void visit_os_device(hwgraph::Graph &graph, const hwloc_obj_t obj) {
+  const hwloc_obj_t parent = obj->parent;
+  const Vertex::Type type = os_device_type(obj);
+  if (!parent || parent->type != HWLOC_OBJ_PCI_DEVICE || !obj->name ||
+      type == Vertex::Type::Unknown) {
+    return;
+  }
+
+  const auto pci = parent->attr->pcidev;
+  Vertex_t dev = graph.get_pci({pci.domain, pci.bus, pci.dev, pci.func});
+  if (!dev) {
+    return; // not a device we added
+  }
+  if (dev->type_ == Vertex::Type::PciDev) {
+    auto typed = std::make_shared<Vertex>(type);
+    typed->name_ = dev->name_;
+    typed->data_.osDev.pciDev = dev->data_.pciDev;
+    graph.replace(dev, typed);
+    dev = typed;
+  }
+  if (dev->type_ == type) {
+    dev->data_.osDev.add_name(obj->name);
+  }
+}
+
 inline void descend_pci_tree(hwloc_topology_t topology, hwgraph::Graph &graph,
                              hwloc_obj_t obj, std::set<hwloc_obj_t> &visited,
                              int depth = 0) {
@@ -232,6 +578,11 @@ inline void descend_pci_tree(hwloc_topology_t topology, hwgraph::Graph &graph,
     auto hub = Vertex::new_bridge(obj->name, bridgeAddr, dn_pci.domain,
                                   dn_pci.secondary_bus, dn_pci.subordinate_bus);
 
+    // Find the NUMA node this package lives in
+    auto nonIoAncestor = hwloc_get_non_io_ancestor_obj(topology, obj);
+    assert(nonIoAncestor);
+    hub->data_.bridge_.locality = locality(nonIoAncestor);
+
     std::cerr << "descend_pci_tree(): " << hub->str() << "\n";
 
     graph.insert_vertex(hub);
@@ -240,10 +591,6 @@ inline void descend_pci_tree(hwloc_topology_t topology, hwgraph::Graph &graph,
       std::cerr << obj->infos[i].name << "::" << obj->infos[i].value;
     }
 
-    // Find the NUMA node this package lives in
-    auto nonIoAncestor = hwloc_get_non_io_ancestor_obj(topology, obj);
-    assert(nonIoAncestor);
-
     // find the upstream packages that occupy the same numa nodes
     const int numPackages =
         hwloc_get_nbobjs_by_type(topology, HWLOC_OBJ_PACKAGE);
@@ -294,7 +641,7 @@ inline void descend_pci_tree(hwloc_topology_t topology, hwgraph::Graph &graph,
     std::cerr << "MISC device " << obj->name << "\n";
   } else if (obj->type == HWLOC_OBJ_OS_DEVICE) {
     std::cerr << "OS Device " << obj->name << "\n";
-    // visit_os_device(graph, obj, visited);
+    visit_os_device(graph, obj);
   } else {
     std::cerr << "Other kind of device " << obj->name << "\n";
     for (unsigned i = 0; i < obj->infos_count; ++i) {
@@ -309,16 +656,17 @@ inline void descend_pci_tree(hwloc_topology_t topology, hwgraph::Graph &graph,
     auto child = obj->children[i];
     descend_pci_tree(topology, graph, child, visited, depth + 1);
   }
+#if HWLOC_API_VERSION >= 0x00020000
+  // hwloc 2 keeps I/O objects in a separate list of children
+  for (hwloc_obj_t child = obj->io_first_child; child;
+       child = child->next_sibling) {
+    descend_pci_tree(topology, graph, child, visited, depth + 1);
+  }
+#endif
 }
 
-inline void add_pci(hwgraph::Graph &graph) {
-  hwloc_topology_t topology;
-
-  hwloc_topology_init(&topology);
-  hwloc_topology_set_flags(topology, HWLOC_TOPOLOGY_FLAG_WHOLE_SYSTEM |
-                                         HWLOC_TOPOLOGY_FLAG_IO_BRIDGES |
-                                         HWLOC_TOPOLOGY_FLAG_WHOLE_IO);
-  hwloc_topology_load(topology);
+inline void add_pci(hwgraph::Graph &graph, const Topology &topo) {
+  hwloc_topology_t topology = topo.get();
 
   // Descend down into each PCI bridge
   const int bridgeDepth = hwloc_get_type_depth(topology, HWLOC_OBJ_BRIDGE);
@@ -336,8 +684,11 @@ inline void add_pci(hwgraph::Graph &graph) {
       descend_pci_tree(topology, graph, bridge, visited);
     }
   }
+}
 
-  hwloc_topology_destroy(topology);
+inline void add_pci(hwgraph::Graph &graph) {
+  Topology topo;
+  add_pci(graph, topo);
 }
 
 } // namespace hwloc
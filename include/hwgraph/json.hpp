@@ -0,0 +1,448 @@
+#pragma once
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include "graph.hpp"
+
+namespace hwgraph {
+namespace json {
+
+typedef nlohmann::json json_t;
+
+inline json_t to_json(const PciAddress &addr) { return addr.str(); }
+
+inline PciAddress pci_address_from_json(const json_t &j) {
+  unsigned dom, bus, dev, func;
+  const std::string s = j.get<std::string>();
+  if (4 != std::sscanf(s.c_str(), "%x:%x:%x.%x", &dom, &bus, &dev, &func)) {
+    throw std::runtime_error("bad PCI address " + s);
+  }
+  PciAddress ret = {PciAddress::domain_type(dom), PciAddress::bus_type(bus),
+                    PciAddress::dev_type(dev), PciAddress::func_type(func)};
+  return ret;
+}
+
+inline json_t to_json(const PciDeviceData &d) {
+  json_t j;
+  j["addr"] = to_json(d.addr);
+  j["classId"] = d.classId;
+  j["vendorId"] = d.vendorId;
+  j["deviceId"] = d.deviceId;
+  j["subvendorId"] = d.subvendorId;
+  j["subdeviceId"] = d.subdeviceId;
+  j["revision"] = d.revision;
+  j["linkSpeed"] = d.linkSpeed;
+  return j;
+}
+
+inline PciDeviceData pci_device_from_json(const json_t &j) {
+  PciDeviceData d;
+  std::memset(&d, 0, sizeof(d));
+  d.addr = pci_address_from_json(j.at("addr"));
+  d.classId = j.at("classId").get<unsigned short>();
+  d.vendorId = j.at("vendorId").get<unsigned short>();
+  d.deviceId = j.at("deviceId").get<unsigned short>();
+  d.subvendorId = j.at("subvendorId").get<unsigned short>();
+  d.subdeviceId = j.at("subdeviceId").get<unsigned short>();
+  d.revision = j.at("revision").get<unsigned char>();
+  d.linkSpeed = j.at("linkSpeed").get<float>();
+  return d;
+}
+
+/* add "cpuset" and "nodeset" masks to j, unless l is unknown
+ */
+inline void add_locality(json_t &j, const Locality &l) {
+  if (!l.empty()) {
+    j["cpuset"] = Locality::mask_str(l.cpus, Locality::MAX_CPUS / 64);
+    j["nodeset"] = Locality::mask_str(l.nodes, Locality::MAX_NODES / 64);
+  }
+}
+
+inline Locality locality_from_json(const json_t &j) {
+  Locality l;
+  std::memset(&l, 0, sizeof(l));
+  if (j.count("cpuset") &&
+      !Locality::mask_from_str(j.at("cpuset").get<std::string>(), l.cpus,
+                               Locality::MAX_CPUS / 64)) {
+    throw std::runtime_error("bad cpuset " + j.at("cpuset").dump());
+  }
+  if (j.count("nodeset") &&
+      !Locality::mask_from_str(j.at("nodeset").get<std::string>(), l.nodes,
+                               Locality::MAX_NODES / 64)) {
+    throw std::runtime_error("bad nodeset " + j.at("nodeset").dump());
+  }
+  return l;
+}
+
+inline const char *type_str(Vertex::Type t) {
+  switch (t) {
+  case Vertex::Type::Unknown:
+    return "unknown";
+  case Vertex::Type::Ppc:
+    return "ppc";
+  case Vertex::Type::Intel:
+    return "intel";
+  case Vertex::Type::Bridge:
+    return "bridge";
+  case Vertex::Type::PciDev:
+    return "pcidev";
+  case Vertex::Type::Gpu:
+    return "gpu";
+  case Vertex::Type::NvLinkBridge:
+    return "nvlinkbridge";
+  case Vertex::Type::NvSwitch:
+    return "nvswitch";
+  case Vertex::Type::NumaNode:
+    return "numanode";
+  case Vertex::Type::L3:
+    return "l3";
+  case Vertex::Type::Core:
+    return "core";
+  case Vertex::Type::Nic:
+    return "nic";
+  case Vertex::Type::Storage:
+    return "storage";
+  case Vertex::Type::Coprocessor:
+    return "coprocessor";
+  }
+  return "unknown";
+}
+
+inline const char *type_str(Edge::Type t) {
+  switch (t) {
+  case Edge::Type::Unknown:
+    return "unknown";
+  case Edge::Type::Qpi:
+    return "qpi";
+  case Edge::Type::Xbus:
+    return "xbus";
+  case Edge::Type::Pci:
+    return "pci";
+  case Edge::Type::Nvlink:
+    return "nvlink";
+  case Edge::Type::Memory:
+    return "memory";
+  case Edge::Type::Onchip:
+    return "onchip";
+  }
+  return "unknown";
+}
+
+inline Vertex::Type vertex_type_from_str(const std::string &s) {
+  for (Vertex::Type t :
+       {Vertex::Type::Unknown, Vertex::Type::Ppc, Vertex::Type::Intel,
+        Vertex::Type::Bridge, Vertex::Type::PciDev, Vertex::Type::Gpu,
+        Vertex::Type::NvLinkBridge, Vertex::Type::NvSwitch,
+        Vertex::Type::NumaNode, Vertex::Type::L3, Vertex::Type::Core,
+        Vertex::Type::Nic, Vertex::Type::Storage,
+        Vertex::Type::Coprocessor}) {
+    if (s == type_str(t)) {
+      return t;
+    }
+  }
+  throw std::runtime_error("unknown vertex type " + s);
+}
+
+inline Edge::Type edge_type_from_str(const std::string &s) {
+  for (Edge::Type t : {Edge::Type::Unknown, Edge::Type::Qpi, Edge::Type::Xbus,
+                       Edge::Type::Pci, Edge::Type::Nvlink, Edge::Type::Memory,
+                       Edge::Type::Onchip}) {
+    if (s == type_str(t)) {
+      return t;
+    }
+  }
+  throw std::runtime_error("unknown edge type " + s);
+}
+
+/* id is the vertex's position in the "vertices" array; edges refer to it
+ */
+inline json_t to_json(const Vertex &v, uint64_t id) {
+  json_t j;
+  j["id"] = id;
+  j["type"] = type_str(v.type_);
+  j["name"] = v.name_;
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wswitch-enum"
+  switch (v.type_) {
+  case Vertex::Type::Intel:
+    j["idx"] = v.data_.intel.idx;
+    j["model"] = std::string(v.data_.intel.model);
+    j["vendor"] = std::string(v.data_.intel.vendor);
+    j["modelNumber"] = v.data_.intel.modelNumber;
+    j["familyNumber"] = v.data_.intel.familyNumber;
+    j["stepping"] = v.data_.intel.stepping;
+    add_locality(j, v.data_.intel.locality);
+    break;
+  case Vertex::Type::Ppc:
+    j["idx"] = v.data_.ppc_.idx;
+    j["model"] = std::string(v.data_.ppc_.model);
+    j["revision"] = v.data_.ppc_.revision;
+    add_locality(j, v.data_.ppc_.locality);
+    break;
+  case Vertex::Type::Bridge:
+    j["addr"] = to_json(v.data_.bridge_.addr);
+    j["domain"] = v.data_.bridge_.domain.domain_;
+    j["secondaryBus"] = v.data_.bridge_.secondaryBus.bus_;
+    j["subordinateBus"] = v.data_.bridge_.subordinateBus.bus_;
+    add_locality(j, v.data_.bridge_.locality);
+    break;
+  case Vertex::Type::PciDev:
+    j["pciDev"] = to_json(v.data_.pciDev);
+    break;
+  case Vertex::Type::Gpu:
+    j["pciDev"] = to_json(v.data_.gpu.pciDev);
+    j["ccMajor"] = v.data_.gpu.ccMajor;
+    j["ccMinor"] = v.data_.gpu.ccMinor;
+    break;
+  case Vertex::Type::NvLinkBridge:
+    j["pciDev"] = to_json(v.data_.nvLinkBridge.pciDev);
+    break;
+  case Vertex::Type::NvSwitch:
+    j["pciDev"] = to_json(v.data_.nvSwitch.pciDev);
+    break;
+  case Vertex::Type::NumaNode:
+    j["idx"] = v.data_.numaNode.idx;
+    j["memory"] = v.data_.numaNode.memory;
+    add_locality(j, v.data_.numaNode.locality);
+    break;
+  case Vertex::Type::L3:
+    j["idx"] = v.data_.l3.idx;
+    j["size"] = v.data_.l3.size;
+    add_locality(j, v.data_.l3.locality);
+    break;
+  case Vertex::Type::Core:
+    j["idx"] = v.data_.core.idx;
+    j["pkgIdx"] = v.data_.core.pkgIdx;
+    add_locality(j, v.data_.core.locality);
+    break;
+  case Vertex::Type::Nic:
+  case Vertex::Type::Storage:
+  case Vertex::Type::Coprocessor:
+    j["pciDev"] = to_json(v.data_.osDev.pciDev);
+    j["osDevices"] = std::string(v.data_.osDev.names);
+    break;
+  default:
+    break;
+  }
+#pragma GCC diagnostic pop
+  return j;
+}
+
+inline Vertex_t vertex_from_json(const json_t &j) {
+  auto v = std::make_shared<Vertex>(
+      vertex_type_from_str(j.at("type").get<std::string>()));
+  v->name_ = j.at("name").get<std::string>();
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wswitch-enum"
+  switch (v->type_) {
+  case Vertex::Type::Intel:
+    v->data_.intel.idx = j.at("idx").get<unsigned>();
+    std::strncpy(v->data_.intel.model,
+                 j.at("model").get<std::string>().c_str(), MAX_STR - 1);
+    std::strncpy(v->data_.intel.vendor,
+                 j.at("vendor").get<std::string>().c_str(), MAX_STR - 1);
+    v->data_.intel.modelNumber = j.at("modelNumber").get<int>();
+    v->data_.intel.familyNumber = j.at("familyNumber").get<int>();
+    v->data_.intel.stepping = j.at("stepping").get<int>();
+    v->data_.intel.locality = locality_from_json(j);
+    break;
+  case Vertex::Type::Ppc:
+    v->data_.ppc_.idx = j.at("idx").get<unsigned>();
+    std::strncpy(v->data_.ppc_.model, j.at("model").get<std::string>().c_str(),
+                 MAX_STR - 1);
+    v->data_.ppc_.revision = j.at("revision").get<int>();
+    v->data_.ppc_.locality = locality_from_json(j);
+    break;
+  case Vertex::Type::Bridge:
+    v->data_.bridge_.addr = pci_address_from_json(j.at("addr"));
+    v->data_.bridge_.domain.domain_ = j.at("domain").get<unsigned short>();
+    v->data_.bridge_.secondaryBus.bus_ =
+        j.at("secondaryBus").get<unsigned char>();
+    v->data_.bridge_.subordinateBus.bus_ =
+        j.at("subordinateBus").get<unsigned char>();
+    v->data_.bridge_.locality = locality_from_json(j);
+    break;
+  case Vertex::Type::PciDev:
+    v->data_.pciDev = pci_device_from_json(j.at("pciDev"));
+    break;
+  case Vertex::Type::Gpu:
+    v->data_.gpu.pciDev = pci_device_from_json(j.at("pciDev"));
+    v->data_.gpu.ccMajor = j.at("ccMajor").get<int>();
+    v->data_.gpu.ccMinor = j.at("ccMinor").get<int>();
+    break;
+  case Vertex::Type::NvLinkBridge:
+    v->data_.nvLinkBridge.pciDev = pci_device_from_json(j.at("pciDev"));
+    break;
+  case Vertex::Type::NvSwitch:
+    v->data_.nvSwitch.pciDev = pci_device_from_json(j.at("pciDev"));
+    break;
+  case Vertex::Type::NumaNode:
+    v->data_.numaNode.idx = j.at("idx").get<unsigned>();
+    v->data_.numaNode.memory = j.at("memory").get<uint64_t>();
+    v->data_.numaNode.locality = locality_from_json(j);
+    break;
+  case Vertex::Type::L3:
+    v->data_.l3.idx = j.at("idx").get<unsigned>();
+    v->data_.l3.size = j.at("size").get<uint64_t>();
+    v->data_.l3.locality = locality_from_json(j);
+    break;
+  case Vertex::Type::Core:
+    v->data_.core.idx = j.at("idx").get<unsigned>();
+    v->data_.core.pkgIdx = j.at("pkgIdx").get<unsigned>();
+    v->data_.core.locality = locality_from_json(j);
+    break;
+  case Vertex::Type::Nic:
+  case Vertex::Type::Storage:
+  case Vertex::Type::Coprocessor:
+    v->data_.osDev.pciDev = pci_device_from_json(j.at("pciDev"));
+    std::strncpy(v->data_.osDev.names,
+                 j.at("osDevices").get<std::string>().c_str(), MAX_STR - 1);
+    break;
+  default:
+    break;
+  }
+#pragma GCC diagnostic pop
+  return v;
+}
+
+inline json_t to_json(const Edge &e, uint64_t u, uint64_t v) {
+  json_t j;
+  j["u"] = u;
+  j["v"] = v;
+  j["type"] = type_str(e.type_);
+  if (e.latency_ >= 0) {
+    j["latency"] = e.latency_;
+  }
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wswitch-enum"
+  switch (e.type_) {
+  case Edge::Type::Qpi:
+    j["links"] = e.data_.qpi_.links_;
+    j["speed"] = e.data_.qpi_.speed_;
+    break;
+  case Edge::Type::Xbus:
+    j["bw"] = e.data_.xbus_.bw_;
+    break;
+  case Edge::Type::Pci:
+    j["linkSpeed"] = e.data_.pci.linkSpeed;
+    j["lanes"] = e.data_.pci.lanes;
+    break;
+  case Edge::Type::Nvlink:
+    j["version"] = e.data_.nvlink.version;
+    j["lanes"] = e.data_.nvlink.lanes;
+    break;
+  case Edge::Type::Memory:
+    j["bw"] = e.data_.memory_.bw_;
+    break;
+  default:
+    break;
+  }
+#pragma GCC diagnostic pop
+  return j;
+}
+
+inline Edge_t edge_from_json(const json_t &j) {
+  auto e =
+      std::make_shared<Edge>(edge_type_from_str(j.at("type").get<std::string>()));
+  if (j.count("latency")) {
+    e->latency_ = j.at("latency").get<double>();
+  }
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wswitch-enum"
+  switch (e->type_) {
+  case Edge::Type::Qpi:
+    e->data_.qpi_.links_ = j.at("links").get<int64_t>();
+    e->data_.qpi_.speed_ = j.at("speed").get<int64_t>();
+    break;
+  case Edge::Type::Xbus:
+    e->data_.xbus_.bw_ = j.at("bw").get<int64_t>();
+    break;
+  case Edge::Type::Pci:
+    e->data_.pci.linkSpeed = j.at("linkSpeed").get<float>();
+    e->data_.pci.lanes = j.at("lanes").get<int64_t>();
+    break;
+  case Edge::Type::Nvlink:
+    e->data_.nvlink.version = j.at("version").get<unsigned>();
+    e->data_.nvlink.lanes = j.at("lanes").get<int64_t>();
+    break;
+  case Edge::Type::Memory:
+    e->data_.memory_.bw_ = j.at("bw").get<int64_t>();
+    break;
+  default:
+    break;
+  }
+#pragma GCC diagnostic pop
+  return e;
+}
+
+/* Write g to os as
+   {"vertices": [...], "edges": [...]}
+   one vertex or edge at a time, so the document is never held in memory
+*/
+inline void write(std::ostream &os, const Graph &g) {
+  std::map<Vertex_t, uint64_t> ids;
+
+  os << "{\"vertices\":[";
+  for (const auto &v : g.vertices()) {
+    const uint64_t id = ids.size();
+    ids[v] = id;
+    if (id) {
+      os << ",";
+    }
+    os << "\n" << to_json(*v, id).dump();
+  }
+
+  os << "],\n\"edges\":[";
+  bool first = true;
+  for (const auto &e : g.edges()) {
+    if (!first) {
+      os << ",";
+    }
+    first = false;
+    os << "\n" << to_json(*e, ids.at(e->u_), ids.at(e->v_)).dump();
+  }
+  os << "]}\n";
+}
+
+/* Build a Graph from a document produced by write()
+ */
+inline Graph read(std::istream &is) {
+  const json_t doc = json_t::parse(is);
+  const json_t &vertices = doc.at("vertices");
+
+  Graph g;
+  std::vector<Vertex_t> byId(vertices.size());
+  for (const auto &jv : vertices) {
+    const uint64_t id = jv.at("id").get<uint64_t>();
+    if (id >= byId.size()) {
+      throw std::runtime_error("vertex id out of range");
+    }
+    byId[id] = vertex_from_json(jv);
+    g.insert_vertex(byId[id]);
+  }
+
+  for (const auto &je : doc.at("edges")) {
+    const uint64_t u = je.at("u").get<uint64_t>();
+    const uint64_t v = je.at("v").get<uint64_t>();
+    if (u >= byId.size() || v >= byId.size() || !byId[u] || !byId[v]) {
+      throw std::runtime_error("edge refers to missing vertex");
+    }
+    g.join(byId[u], byId[v], edge_from_json(je));
+  }
+  return g;
+}
+
+} // namespace json
+} // namespace hwgraph
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstdint>
+
+/* Link bandwidth models. All bandwidths are bytes per second in each
+   direction of the link
+*/
+
+namespace hwgraph {
+
+/* one PCIe lane, indexed by generation. Generations 1 and 2 use 8b/10b
+   encoding, 3 to 5 use 128b/130b, and 6 uses 242B/256B FLITs
+*/
+constexpr int64_t PCIE_LANE_BANDWIDTH[] = {
+    0,          // unknown
+    250000000,  // 2.5 GT/s
+    500000000,  // 5 GT/s
+    984615384,  // 8 GT/s
+    1969230769, // 16 GT/s
+    3938461538, // 32 GT/s
+    7562500000, // 64 GT/s
+};
+
+/* one NVLink link, indexed by the nvmlNvlinkVersion_t that
+   nvmlDeviceGetNvLinkVersion() reports, which is not the NVLink generation.
+   NVSwitch ports are NVLinks of the same version as the GPU, so they share
+   this table
+*/
+constexpr int64_t NVLINK_LANE_BANDWIDTH[] = {
+    0,           // NVML_NVLINK_VERSION_INVALID
+    20000000000, // NVML_NVLINK_VERSION_1_0, P100
+    25000000000, // NVML_NVLINK_VERSION_2_0, V100
+    25000000000, // NVML_NVLINK_VERSION_2_2
+    25000000000, // NVML_NVLINK_VERSION_3_0, A100
+    25000000000, // NVML_NVLINK_VERSION_3_1, A100
+    25000000000, // NVML_NVLINK_VERSION_4_0, H100
+    50000000000, // NVML_NVLINK_VERSION_5_0, B200
+};
+
+constexpr unsigned int PCIE_MAX_GENERATION =
+    sizeof(PCIE_LANE_BANDWIDTH) / sizeof(PCIE_LANE_BANDWIDTH[0]) - 1;
+constexpr unsigned int NVLINK_MAX_VERSION =
+    sizeof(NVLINK_LANE_BANDWIDTH) / sizeof(NVLINK_LANE_BANDWIDTH[0]) - 1;
+
+/* bandwidth of a PCIe link, or 0 for an unknown generation
+ */
+constexpr int64_t pcie_bandwidth(unsigned int generation, int64_t lanes) {
+  return generation <= PCIE_MAX_GENERATION
+             ? PCIE_LANE_BANDWIDTH[generation] * lanes
+             : 0;
+}
+
+/* bandwidth of an NVLink connection made of lanes links, or 0 for an unknown
+   version
+*/
+constexpr int64_t nvlink_bandwidth(unsigned int version, int64_t lanes) {
+  return version <= NVLINK_MAX_VERSION ? NVLINK_LANE_BANDWIDTH[version] * lanes
+                                       : 0;
+}
+
+/* the PCIe generation whose per-lane bandwidth is closest to that of a link
+   with bytesPerSecond over lanes lanes, or 0 if lanes is not positive
+*/
+inline unsigned int pcie_generation(double bytesPerSecond, int64_t lanes) {
+  if (lanes <= 0 || bytesPerSecond <= 0) {
+    return 0;
+  }
+  const double perLane = bytesPerSecond / lanes;
+  unsigned int best = 1;
+  for (unsigned int gen = 2; gen <= PCIE_MAX_GENERATION; ++gen) {
+    const double d = perLane - PCIE_LANE_BANDWIDTH[gen];
+    const double bestD = perLane - PCIE_LANE_BANDWIDTH[best];
+    if (d * d < bestD * bestD) {
+      best = gen;
+    }
+  }
+  return best;
+}
+
+} // namespace hwgraph
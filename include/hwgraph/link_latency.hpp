@@ -0,0 +1,16 @@
+#pragma once
+
+/* Default one-way link latencies in seconds, for edges without a measured
+   latency. These are typical figures for an idle link, not guarantees
+*/
+
+namespace hwgraph {
+
+constexpr double PCIE_SWITCH_HOP_LATENCY = 150e-9; // through a PCIe switch
+constexpr double PCIE_ROOT_COMPLEX_LATENCY = 300e-9; // CPU to host bridge
+constexpr double QPI_LATENCY = 100e-9;  // QPI / UPI socket hop
+constexpr double XBUS_LATENCY = 100e-9; // POWER X-Bus socket hop
+constexpr double NVLINK_LATENCY = 100e-9; // GPU to GPU or NVSwitch hop
+constexpr double MEMORY_LATENCY = 90e-9; // package to its local DRAM
+
+} // namespace hwgraph
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <algorithm>
+#include <cstdint>
 #include <vector>
 
 template <typename T> class Mat2D {
@@ -9,31 +11,33 @@ template <typename T> class Mat2D {
   int64_t c_;
 
 public:
-    Mat2D(int64_t r, int64_t c) : elems_(r * c), r_(r), c_(c) {
+  Mat2D(int64_t r, int64_t c) : elems_(r * c), r_(r), c_(c) {}
+  Mat2D() : r_(0), c_(0) {}
+  Mat2D(int64_t r, int64_t c, const T &val) : elems_(r * c, val), r_(r), c_(c) {}
 
-    }
-    Mat2D() : r_(0), c_(0) {}
-    Mat2D(int64_t r, int64_t c, T& val) : elems(r * c, val), r_(r), c_(c) {
+  Mat2D(Mat2D &&other) = default;
+  Mat2D(const Mat2D &other) = default;
+  Mat2D &operator=(Mat2D &&other) = default;
+  Mat2D &operator=(const Mat2D &other) = default;
 
-    }
-
-    Mat2D(Mat2D &&other) = default;
-    Mat2D(const Mat2D &other) = default;
-    ~Mat2D() {
-        r_ = 0;
-        c_ = 0;
-    }
+  int64_t rows() const noexcept { return r_; }
+  int64_t cols() const noexcept { return c_; }
 
   void resize(int64_t r, int64_t c) {
     std::vector<T> newElems_(r * c);
     for (int64_t i = 0; i < std::min(r, r_); ++i) {
       for (int64_t j = 0; j < std::min(c, c_); ++j) {
-        newElems_[i * c + j] = std::move(i * c_ + j);
+        newElems_[i * c + j] = std::move(elems_[i * c_ + j]);
       }
     }
     elems_ = std::move(newElems_);
+    r_ = r;
+    c_ = c;
   }
 
-  T *&operator[](size_t i) { return &vector[i * c_]; }
-  const T *&operator[](size_t i) const { return &vector[i * c_]; }
-};
\ No newline at end of file
+  T &operator()(int64_t i, int64_t j) { return elems_[i * c_ + j]; }
+  const T &operator()(int64_t i, int64_t j) const { return elems_[i * c_ + j]; }
+
+  T *operator[](size_t i) { return &elems_[i * c_]; }
+  const T *operator[](size_t i) const { return &elems_[i * c_]; }
+};
@@ -2,15 +2,21 @@
 
 #include <cstdio>
 #include <iostream>
+#include <mutex>
+#include <string>
+#include <utility>
 
 #include <nvml.h>
 
 #include "graph.hpp"
-#include "narrow.hpp"
+#include "nvml_backend.hpp"
 
 namespace hwgraph {
 namespace nvml {
 
+static_assert(NVML_NVLINK_MAX_LINKS <= NVLINK_MAX_LINKS,
+              "add_nvlinks() would not scan every NVLink");
+
 inline void checkNvml(nvmlReturn_t result, const char *file, const int line) {
   if (result != NVML_SUCCESS) {
     fprintf(stderr, "nvml Error: %s in %s : %d\n", nvmlErrorString(result),
@@ -21,208 +27,125 @@ inline void checkNvml(nvmlReturn_t result, const char *file, const int line) {
 
 #define NVML(stmt) checkNvml(stmt, __FILE__, __LINE__);
 
-static bool once = false;
-class Initer {
-private:
+/* Reference-counted NVML initialization.
+   nvmlInit() runs when the first Session is created and nvmlShutdown() when
+   the last one is destroyed. Discovery functions hold a Session while they
+   run; hold one yourself to keep NVML loaded across several calls.
+*/
+class Session {
 public:
-  Initer() {
-    if (!once) {
+  Session() {
+    std::lock_guard<std::mutex> lock(mutex());
+    if (0 == count()++) {
       NVML(nvmlInit());
-      once = true;
     }
   }
-};
 
-Initer initer;
+  ~Session() {
+    std::lock_guard<std::mutex> lock(mutex());
+    if (0 == --count()) {
+      NVML(nvmlShutdown());
+    }
+  }
 
-// https://github.com/NVIDIA/nccl/blob/6c61492eba5c25ac6ed1bf57de23c6a689aa75cc/src/graph/topo.cc#L222
-inline void add_gpus(hwgraph::Graph &graph) {
+  Session(const Session &other) = delete;
+  Session &operator=(const Session &other) = delete;
 
-  unsigned int deviceCount;
-  NVML(nvmlDeviceGetCount(&deviceCount));
-  for (unsigned int devIdx = 0; devIdx < deviceCount; ++devIdx) {
+  /* number of live sessions. NVML is initialized iff this is non-zero
+   */
+  static int active() {
+    std::lock_guard<std::mutex> lock(mutex());
+    return count();
+  }
 
-    std::cerr << "Querying NVML device " << devIdx << "\n";
-    nvmlDevice_t dev;
-    NVML(nvmlDeviceGetHandleByIndex(devIdx, &dev));
+private:
+  static int &count() {
+    static int c = 0;
+    return c;
+  }
+  static std::mutex &mutex() {
+    static std::mutex m;
+    return m;
+  }
+};
 
-    // Get the PCI address of this device
-    std::cerr << "Get PCI Info for device " << devIdx << "\n";
-    nvmlPciInfo_t pciInfo;
-    NVML(nvmlDeviceGetPciInfo(dev, &pciInfo));
-    PciAddress addr = {safe_narrow<short unsigned int>(pciInfo.domain),
-                       safe_narrow<unsigned char>(pciInfo.bus),
-                       safe_narrow<unsigned char>(pciInfo.device), 0};
-    auto local = graph.get_pci(addr);
+/* Backend that asks the NVML library. NVML is initialized while it exists
+ */
+class LiveBackend : public Backend {
+public:
+  unsigned int device_count() override {
+    unsigned int deviceCount;
+    NVML(nvmlDeviceGetCount(&deviceCount));
+    return deviceCount;
+  }
 
-    std::cerr << "matching device in graph: " << devIdx << "\n";
-    std::cerr << local->str() << "\n";
+  PciInfo pci_info(unsigned int dev) override {
+    nvmlPciInfo_t pciInfo;
+    NVML(nvmlDeviceGetPciInfo(handle(dev), &pciInfo));
+    return {pciInfo.domain, pciInfo.bus, pciInfo.device};
+  }
 
-    // get the name of this device
-    std::cerr << "Get name for device " << devIdx << "\n";
+  std::string name(unsigned int dev) override {
     char name[64]; // nvml says 64 is the max size
-    NVML(nvmlDeviceGetName(dev, name, sizeof(name)));
-
-    std::cerr << "make new GPU\n";
-    Vertex_t gpu = Vertex::new_gpu(name);
-    std::cerr << gpu->str() << "\n";
-
-    std::cerr << "take pci info\n";
-    // update it with existing PCI info, if found
-    if (local) {
-      if (local->type_ == Vertex::Type::PciDev) {
-        gpu->data_.gpu.pciDev = local->data_.pciDev;
-      } else {
-        assert(0);
-      }
-    }
+    NVML(nvmlDeviceGetName(handle(dev), name, sizeof(name)));
+    return name;
+  }
 
-    std::cerr << "get CUDA CC\n";
+  std::pair<int, int> cuda_compute_capability(unsigned int dev) override {
     int cudaMajor, cudaMinor;
-    NVML(nvmlDeviceGetCudaComputeCapability(dev, &cudaMajor, &cudaMinor));
-    gpu->data_.gpu.ccMajor = cudaMajor;
-    gpu->data_.gpu.ccMinor = cudaMinor;
-
-    if (local) {
-      std::cerr << "add_gpus(): replace\n";
-
-      graph.replace(local, gpu);
+    NVML(nvmlDeviceGetCudaComputeCapability(handle(dev), &cudaMajor,
+                                            &cudaMinor));
+    return std::make_pair(cudaMajor, cudaMinor);
+  }
 
-    } else {
-      std::cerr << "add_gpus(): new\n";
-      graph.insert_vertex(gpu);
+  LinkState nvlink_state(unsigned int dev, unsigned int link) override {
+    nvmlEnableState_t isActive;
+    const auto ret = nvmlDeviceGetNvLinkState(handle(dev), link, &isActive);
+    // NVML rejects link indices past the device's last link
+    if (NVML_ERROR_NOT_SUPPORTED == ret ||
+        NVML_ERROR_INVALID_ARGUMENT == ret) {
+      return LinkState::Unsupported;
+    } else if (NVML_SUCCESS != ret || NVML_FEATURE_ENABLED != isActive) {
+      return LinkState::Inactive;
     }
+    return LinkState::Active;
   }
-}
-// https://github.com/NVIDIA/nccl/blob/6c61492eba5c25ac6ed1bf57de23c6a689aa75cc/src/graph/topo.cc#L222
-inline void add_nvlinks(hwgraph::Graph &graph) {
-
-  unsigned int deviceCount;
-  NVML(nvmlDeviceGetCount(&deviceCount));
-  for (unsigned int devIdx = 0; devIdx < deviceCount; ++devIdx) {
 
-    std::cerr << "Querying NVML device " << devIdx << "\n";
-    nvmlDevice_t dev;
-    NVML(nvmlDeviceGetHandleByIndex(devIdx, &dev));
-
-    int cudaMajor, cudaMinor;
-    NVML(nvmlDeviceGetCudaComputeCapability(dev, &cudaMajor, &cudaMinor));
-    int maxNvLinks;
-    if (cudaMajor < 6) {
-      maxNvLinks = 0;
-    } else if (cudaMajor == 6) {
-      maxNvLinks = 4;
-    } else {
-      maxNvLinks = 6;
-    }
+  PciInfo nvlink_remote_pci_info(unsigned int dev,
+                                 unsigned int link) override {
+    nvmlPciInfo_t pciInfo;
+    NVML(nvmlDeviceGetNvLinkRemotePciInfo(handle(dev), link, &pciInfo));
+    return {pciInfo.domain, pciInfo.bus, pciInfo.device};
+  }
 
-    for (int l = 0; l < maxNvLinks; ++l) {
-
-      nvmlEnableState_t isActive;
-      const auto ret = nvmlDeviceGetNvLinkState(dev, l, &isActive);
-      if (NVML_ERROR_NOT_SUPPORTED == ret) { // GPU does not support NVLink
-        std::cerr << "GPU does not support NVLink\n";
-        break; // no need to check all links
-      } else if (NVML_FEATURE_ENABLED != isActive) {
-        std::cerr << "link not active on GPU\n";
-        continue;
-      }
-
-      // Get the PCI address of this device
-      nvmlPciInfo_t pciInfo;
-      NVML(nvmlDeviceGetPciInfo(dev, &pciInfo));
-      PciAddress addr = {safe_narrow<short unsigned int>(pciInfo.domain),
-                         safe_narrow<unsigned char>(pciInfo.bus),
-                         safe_narrow<unsigned char>(pciInfo.device), 0};
-      std::cerr << "add_nvlinks(): local " << addr.str() << "\n";
-      auto local = graph.get_pci(addr);
-      assert(local->type_ == Vertex::Type::Gpu);
-
-      // figure out what's on the other side
-      NVML(nvmlDeviceGetNvLinkRemotePciInfo(dev, l, &pciInfo));
-      addr = {safe_narrow<short unsigned int>(pciInfo.domain),
-              safe_narrow<unsigned char>(pciInfo.bus),
-              safe_narrow<unsigned char>(pciInfo.device), 0};
-      auto remote = graph.get_pci(addr);
-
-      /* the NvLink Bridges on the CPUs are emulated PCI device that we did not
-      add during PCI discovery just directly connect to whatever CPU is closest.
-      */
-      if (!remote) {
-        std::cerr << "searching for closest package\n";
-        auto p = graph.shortest_path(local, Vertex::is_package);
-        remote = p.second;
-      }
-
-      if (!remote)
-        std::cerr << "add_nvlinks(): couldn't connect nvlink to anything\n";
-
-      unsigned int version;
-      NVML(nvmlDeviceGetNvLinkVersion(dev, l, &version));
-
-      if (remote->type_ == Vertex::Type::Gpu) {
-        std::cerr << "remote is " << remote->str() << "\n";
-
-        // nvlink will be visible from both sides, so only connect one way
-        if (local->data_.gpu.pciDev.addr < remote->data_.gpu.pciDev.addr) {
-          auto link = Edge::new_nvlink(version, 1);
-          graph.join(local, remote, link);
-        }
-
-      } else if (remote->type_ == Vertex::Type::Ppc) {
-        std::cerr << "remote is " << remote->str() << "\n";
-        auto link = Edge::new_nvlink(version, 1);
-        graph.join(local, remote, link);
-      } else if (remote->type_ == Vertex::Type::NvSwitch) {
-        std::cerr << "nvswitch?\n";
-        std::cerr << "remote is " << remote->str() << "\n";
-        assert(0);
-      } else {
-        std::cerr << "unexpected nvlink endpoint\n";
-        assert(0);
-      }
-    }
+  unsigned int nvlink_version(unsigned int dev, unsigned int link) override {
+    unsigned int version;
+    NVML(nvmlDeviceGetNvLinkVersion(handle(dev), link, &version));
+    return version;
   }
 
-  /*
-  each NvLink connected component may have multiple nvlinks here.
-  We combine them into a single nvlink with a larger lane count
-  */
-
-  bool changed = true;
-  while (changed) {
-    changed = false;
-
-    /*
-    look through all edges for an nvlink
-    if we find one, look for another nvlink between the same verts
-    if we find one, combine them and start over
-    */
-    for (auto &i : graph.edges()) {
-      if (i->type_ == Edge::Type::Nvlink) {
-        for (auto &j : graph.edges()) {
-          if (i != j && i->same_vertices(j)) {
-            std::cerr << "add_nvlinks(): combining " << i->str() << " and "
-                      << j->str() << "\n";
-            assert(i->data_.nvlink.version == j->data_.nvlink.version);
-            i->data_.nvlink.lanes += j->data_.nvlink.lanes;
-            std::cerr << "add_nvlinks(): into " << i->str() << "\n";
-            graph.erase(j); // invalidated iterators
-            changed = true;
-            goto loop_end;
-          }
-        }
-      }
-    }
-  loop_end:;
+private:
+  static nvmlDevice_t handle(unsigned int dev) {
+    nvmlDevice_t ret;
+    NVML(nvmlDeviceGetHandleByIndex(dev, &ret));
+    return ret;
   }
 
-  /*
-  NvLink lanes have been combined
-  GPU-CPU NvLinks are connected to an NvLinkBridge, which is connected to the
-  hostbridge we can treat these connections as infinite bandwidth when computing
-  bandwidth, so this is fine for now
-  */
+  Session session_;
+};
+
+/* add_gpus() using the NVML library
+ */
+inline void add_gpus(hwgraph::Graph &graph) {
+  LiveBackend nvml;
+  add_gpus(graph, nvml);
+}
+
+/* add_nvlinks() using the NVML library
+ */
+inline void add_nvlinks(hwgraph::Graph &graph) {
+  LiveBackend nvml;
+  add_nvlinks(graph, nvml);
 }
 
 } // namespace nvml
@@ -0,0 +1,479 @@
+#pragma once
+
+#include <cassert>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include "graph.hpp"
+#include "narrow.hpp"
+
+/* GPU discovery against an abstract source of NVML answers.
+
+   add_gpus() and add_nvlinks() ask a Backend the questions they would
+   otherwise ask NVML. nvml.hpp provides the LiveBackend that calls the
+   driver; this file has no NVML dependence, so replaying a recording works
+   on machines without a GPU or without NVML at all.
+*/
+
+namespace hwgraph {
+namespace nvml {
+
+struct PciInfo {
+  unsigned int domain;
+  unsigned int bus;
+  unsigned int device;
+
+  PciAddress addr() const {
+    return {safe_narrow<short unsigned int>(domain),
+            safe_narrow<unsigned char>(bus),
+            safe_narrow<unsigned char>(device), 0};
+  }
+};
+
+enum class LinkState {
+  Unsupported, // the GPU has no NVLink, or no link with this index
+  Inactive,
+  Active
+};
+
+/* NVML_NVLINK_MAX_LINKS of the newest NVML, which this file does not include
+ */
+constexpr unsigned int NVLINK_MAX_LINKS = 18;
+
+/* The NVML queries made by GPU discovery. Devices are NVML indices
+ */
+class Backend {
+public:
+  virtual ~Backend() {}
+
+  virtual unsigned int device_count() = 0;
+  virtual PciInfo pci_info(unsigned int dev) = 0;
+  virtual std::string name(unsigned int dev) = 0;
+  virtual std::pair<int, int> cuda_compute_capability(unsigned int dev) = 0;
+  virtual LinkState nvlink_state(unsigned int dev, unsigned int link) = 0;
+  virtual PciInfo nvlink_remote_pci_info(unsigned int dev,
+                                         unsigned int link) = 0;
+  virtual unsigned int nvlink_version(unsigned int dev, unsigned int link) = 0;
+};
+
+/* Every answer a Backend gave, keyed by the question.
+
+   The text format is one answer per line after a header:
+     hwgraph-nvml 1
+     count <n>
+     pci <dev> <domain> <bus> <device>
+     name <dev> <name to end of line>
+     cc <dev> <major> <minor>
+     link <dev> <link> <unsupported|inactive|active>
+     remote <dev> <link> <domain> <bus> <device>
+     version <dev> <link> <version>
+*/
+struct Recording {
+  typedef std::pair<unsigned int, unsigned int> Link; // device, link
+
+  bool hasCount;
+  unsigned int count;
+  std::map<unsigned int, PciInfo> pci;
+  std::map<unsigned int, std::string> names;
+  std::map<unsigned int, std::pair<int, int>> cc;
+  std::map<Link, LinkState> linkState;
+  std::map<Link, PciInfo> remotePci;
+  std::map<Link, unsigned int> linkVersion;
+
+  Recording() : hasCount(false), count(0) {}
+
+  static const char *state_str(LinkState s) {
+    switch (s) {
+    case LinkState::Unsupported:
+      return "unsupported";
+    case LinkState::Inactive:
+      return "inactive";
+    case LinkState::Active:
+      return "active";
+    }
+    assert(0 && "unexpected LinkState");
+    return "";
+  }
+
+  void write(std::ostream &os) const {
+    os << "hwgraph-nvml 1\n";
+    if (hasCount) {
+      os << "count " << count << "\n";
+    }
+    for (const auto &kv : pci) {
+      os << "pci " << kv.first << " " << kv.second.domain << " "
+         << kv.second.bus << " " << kv.second.device << "\n";
+    }
+    for (const auto &kv : names) {
+      os << "name " << kv.first << " " << kv.second << "\n";
+    }
+    for (const auto &kv : cc) {
+      os << "cc " << kv.first << " " << kv.second.first << " "
+         << kv.second.second << "\n";
+    }
+    for (const auto &kv : linkState) {
+      os << "link " << kv.first.first << " " << kv.first.second << " "
+         << state_str(kv.second) << "\n";
+    }
+    for (const auto &kv : remotePci) {
+      os << "remote " << kv.first.first << " " << kv.first.second << " "
+         << kv.second.domain << " " << kv.second.bus << " "
+         << kv.second.device << "\n";
+    }
+    for (const auto &kv : linkVersion) {
+      os << "version " << kv.first.first << " " << kv.first.second << " "
+         << kv.second << "\n";
+    }
+  }
+
+  void write(const std::string &path) const {
+    std::ofstream os(path);
+    write(os);
+    if (!os) {
+      throw std::runtime_error("couldn't write NVML recording " + path);
+    }
+  }
+
+  /* throws std::runtime_error on a malformed recording
+   */
+  static Recording read(std::istream &is) {
+    Recording r;
+    std::string line;
+    if (!std::getline(is, line) || line != "hwgraph-nvml 1") {
+      throw std::runtime_error("not an NVML recording");
+    }
+
+    while (std::getline(is, line)) {
+      if (line.empty()) {
+        continue;
+      }
+      std::istringstream ss(line);
+      std::string kind;
+      unsigned int dev = 0, link = 0;
+      ss >> kind;
+      bool ok = true;
+      if (kind == "count") {
+        ok = bool(ss >> r.count);
+        r.hasCount = true;
+      } else if (kind == "pci") {
+        PciInfo p;
+        ok = bool(ss >> dev >> p.domain >> p.bus >> p.device);
+        r.pci[dev] = p;
+      } else if (kind == "name") {
+        ok = bool(ss >> dev) && ss.get() == ' ';
+        std::getline(ss, r.names[dev]);
+      } else if (kind == "cc") {
+        int major, minor;
+        ok = bool(ss >> dev >> major >> minor);
+        r.cc[dev] = std::make_pair(major, minor);
+      } else if (kind == "link") {
+        std::string s;
+        ok = bool(ss >> dev >> link >> s);
+        if (s == "unsupported") {
+          r.linkState[Link(dev, link)] = LinkState::Unsupported;
+        } else if (s == "inactive") {
+          r.linkState[Link(dev, link)] = LinkState::Inactive;
+        } else if (s == "active") {
+          r.linkState[Link(dev, link)] = LinkState::Active;
+        } else {
+          ok = false;
+        }
+      } else if (kind == "remote") {
+        PciInfo p;
+        ok = bool(ss >> dev >> link >> p.domain >> p.bus >> p.device);
+        r.remotePci[Link(dev, link)] = p;
+      } else if (kind == "version") {
+        unsigned int version;
+        ok = bool(ss >> dev >> link >> version);
+        r.linkVersion[Link(dev, link)] = version;
+      } else {
+        ok = false;
+      }
+      if (!ok) {
+        throw std::runtime_error("bad NVML recording line: " + line);
+      }
+    }
+    return r;
+  }
+
+  static Recording read(const std::string &path) {
+    std::ifstream is(path);
+    if (!is) {
+      throw std::runtime_error("couldn't open NVML recording " + path);
+    }
+    return read(is);
+  }
+};
+
+/* Forwards to another Backend and records every answer
+ */
+class RecordingBackend : public Backend {
+public:
+  explicit RecordingBackend(Backend &inner) : inner_(inner) {}
+
+  const Recording &recording() const { return recording_; }
+
+  unsigned int device_count() override {
+    recording_.count = inner_.device_count();
+    recording_.hasCount = true;
+    return recording_.count;
+  }
+  PciInfo pci_info(unsigned int dev) override {
+    return recording_.pci[dev] = inner_.pci_info(dev);
+  }
+  std::string name(unsigned int dev) override {
+    return recording_.names[dev] = inner_.name(dev);
+  }
+  std::pair<int, int> cuda_compute_capability(unsigned int dev) override {
+    return recording_.cc[dev] = inner_.cuda_compute_capability(dev);
+  }
+  LinkState nvlink_state(unsigned int dev, unsigned int link) override {
+    return recording_.linkState[Recording::Link(dev, link)] =
+               inner_.nvlink_state(dev, link);
+  }
+  PciInfo nvlink_remote_pci_info(unsigned int dev,
+                                 unsigned int link) override {
+    return recording_.remotePci[Recording::Link(dev, link)] =
+               inner_.nvlink_remote_pci_info(dev, link);
+  }
+  unsigned int nvlink_version(unsigned int dev, unsigned int link) override {
+    return recording_.linkVersion[Recording::Link(dev, link)] =
+               inner_.nvlink_version(dev, link);
+  }
+
+private:
+  Backend &inner_;
+  Recording recording_;
+};
+
+/* Serves the answers in a Recording.
+   Throws std::runtime_error for a question that was not recorded
+*/
+class ReplayBackend : public Backend {
+public:
+  explicit ReplayBackend(Recording recording)
+      : recording_(std::move(recording)) {}
+  explicit ReplayBackend(const std::string &path)
+      : recording_(Recording::read(path)) {}
+
+  unsigned int device_count() override {
+    if (!recording_.hasCount) {
+      throw std::runtime_error("device count not recorded");
+    }
+    return recording_.count;
+  }
+  PciInfo pci_info(unsigned int dev) override {
+    return lookup(recording_.pci, dev, "pci");
+  }
+  std::string name(unsigned int dev) override {
+    return lookup(recording_.names, dev, "name");
+  }
+  std::pair<int, int> cuda_compute_capability(unsigned int dev) override {
+    return lookup(recording_.cc, dev, "cc");
+  }
+  LinkState nvlink_state(unsigned int dev, unsigned int link) override {
+    return lookup(recording_.linkState, Recording::Link(dev, link), "link");
+  }
+  PciInfo nvlink_remote_pci_info(unsigned int dev,
+                                 unsigned int link) override {
+    return lookup(recording_.remotePci, Recording::Link(dev, link), "remote");
+  }
+  unsigned int nvlink_version(unsigned int dev, unsigned int link) override {
+    return lookup(recording_.linkVersion, Recording::Link(dev, link),
+                  "version");
+  }
+
+private:
+  template <typename K, typename V>
+  static const V &lookup(const std::map<K, V> &m, const K &k,
+                         const char *what) {
+    auto it = m.find(k);
+    if (it == m.end()) {
+      throw std::runtime_error(std::string("NVML ") + what +
+                               " query not recorded");
+    }
+    return it->second;
+  }
+
+  Recording recording_;
+};
+
+// https://github.com/NVIDIA/nccl/blob/6c61492eba5c25ac6ed1bf57de23c6a689aa75cc/src/graph/topo.cc#L222
+inline void add_gpus(hwgraph::Graph &graph, Backend &nvml) {
+
+  const unsigned int deviceCount = nvml.device_count();
+  for (unsigned int devIdx = 0; devIdx < deviceCount; ++devIdx) {
+
+    std::cerr << "Querying NVML device " << devIdx << "\n";
+
+    // Get the PCI address of this device
+    std::cerr << "Get PCI Info for device " << devIdx << "\n";
+    PciAddress addr = nvml.pci_info(devIdx).addr();
+    auto local = graph.get_pci(addr);
+
+    if (local) {
+      std::cerr << "matching device in graph: " << devIdx << "\n";
+      std::cerr << local->str() << "\n";
+    }
+
+    // get the name of this device
+    std::cerr << "Get name for device " << devIdx << "\n";
+    const std::string name = nvml.name(devIdx);
+
+    std::cerr << "make new GPU\n";
+    Vertex_t gpu = Vertex::new_gpu(name.c_str());
+    std::cerr << gpu->str() << "\n";
+
+    std::cerr << "take pci info\n";
+    // update it with existing PCI info, if found
+    if (local) {
+      if (local->type_ == Vertex::Type::PciDev) {
+        gpu->data_.gpu.pciDev = local->data_.pciDev;
+      } else if (local->type_ == Vertex::Type::Coprocessor) {
+        // hwloc found the GPU's CUDA or OpenCL device
+        gpu->data_.gpu.pciDev = local->data_.osDev.pciDev;
+      } else {
+        assert(0);
+      }
+    } else {
+      gpu->data_.gpu.pciDev.addr = addr;
+    }
+
+    std::cerr << "get CUDA CC\n";
+    const std::pair<int, int> cc = nvml.cuda_compute_capability(devIdx);
+    gpu->data_.gpu.ccMajor = cc.first;
+    gpu->data_.gpu.ccMinor = cc.second;
+
+    if (local) {
+      std::cerr << "add_gpus(): replace\n";
+
+      graph.replace(local, gpu);
+
+    } else {
+      std::cerr << "add_gpus(): new\n";
+      graph.insert_vertex(gpu);
+    }
+  }
+}
+
+// https://github.com/NVIDIA/nccl/blob/6c61492eba5c25ac6ed1bf57de23c6a689aa75cc/src/graph/topo.cc#L222
+inline void add_nvlinks(hwgraph::Graph &graph, Backend &nvml) {
+
+  const unsigned int deviceCount = nvml.device_count();
+  for (unsigned int devIdx = 0; devIdx < deviceCount; ++devIdx) {
+
+    std::cerr << "Querying NVML device " << devIdx << "\n";
+
+    if (nvml.cuda_compute_capability(devIdx).first < 6) {
+      continue; // no NVLink before Pascal
+    }
+
+    for (unsigned int l = 0; l < NVLINK_MAX_LINKS; ++l) {
+
+      const LinkState state = nvml.nvlink_state(devIdx, l);
+      if (LinkState::Unsupported == state) {
+        std::cerr << "no NVLink " << l << " on GPU\n";
+        break; // no NVLink, or past the GPU's last link
+      } else if (LinkState::Active != state) {
+        std::cerr << "link not active on GPU\n";
+        continue;
+      }
+
+      // Get the PCI address of this device
+      PciAddress addr = nvml.pci_info(devIdx).addr();
+      std::cerr << "add_nvlinks(): local " << addr.str() << "\n";
+      auto local = graph.get_pci(addr);
+      assert(local->type_ == Vertex::Type::Gpu);
+
+      // figure out what's on the other side
+      addr = nvml.nvlink_remote_pci_info(devIdx, l).addr();
+      auto remote = graph.get_pci(addr);
+
+      /* the NvLink Bridges on the CPUs are emulated PCI device that we did not
+      add during PCI discovery just directly connect to whatever CPU is closest.
+      */
+      if (!remote) {
+        std::cerr << "searching for closest package\n";
+        auto p = graph.shortest_path(local, Vertex::is_package);
+        remote = p.second;
+      }
+
+      if (!remote) {
+        std::cerr << "add_nvlinks(): couldn't connect nvlink to anything\n";
+        continue;
+      }
+
+      const unsigned int version = nvml.nvlink_version(devIdx, l);
+
+      if (remote->type_ == Vertex::Type::Gpu) {
+        std::cerr << "remote is " << remote->str() << "\n";
+
+        // nvlink will be visible from both sides, so only connect one way
+        if (local->data_.gpu.pciDev.addr < remote->data_.gpu.pciDev.addr) {
+          auto link = Edge::new_nvlink(version, 1);
+          graph.join(local, remote, link);
+        }
+
+      } else if (remote->type_ == Vertex::Type::Ppc) {
+        std::cerr << "remote is " << remote->str() << "\n";
+        auto link = Edge::new_nvlink(version, 1);
+        graph.join(local, remote, link);
+      } else if (remote->type_ == Vertex::Type::NvSwitch) {
+        std::cerr << "nvswitch?\n";
+        std::cerr << "remote is " << remote->str() << "\n";
+        assert(0);
+      } else {
+        std::cerr << "unexpected nvlink endpoint\n";
+        assert(0);
+      }
+    }
+  }
+
+  /*
+  each NvLink connected component may have multiple nvlinks here.
+  We combine them into a single nvlink with a larger lane count
+  */
+
+  bool changed = true;
+  while (changed) {
+    changed = false;
+
+    /*
+    look through all edges for an nvlink
+    if we find one, look for another nvlink between the same verts
+    if we find one, combine them and start over
+    */
+    for (auto &i : graph.edges()) {
+      if (i->type_ == Edge::Type::Nvlink) {
+        for (auto &j : graph.edges()) {
+          if (i != j && i->same_vertices(j)) {
+            std::cerr << "add_nvlinks(): combining " << i->str() << " and "
+                      << j->str() << "\n";
+            assert(i->data_.nvlink.version == j->data_.nvlink.version);
+            i->data_.nvlink.lanes += j->data_.nvlink.lanes;
+            std::cerr << "add_nvlinks(): into " << i->str() << "\n";
+            graph.erase(j); // invalidated iterators
+            changed = true;
+            goto loop_end;
+          }
+        }
+      }
+    }
+  loop_end:;
+  }
+
+  /*
+  NvLink lanes have been combined
+  GPU-CPU NvLinks are connected to an NvLinkBridge, which is connected to the
+  hostbridge we can treat these connections as infinite bandwidth when computing
+  bandwidth, so this is fine for now
+  */
+}
+
+} // namespace nvml
+} // namespace hwgraph
@@ -1,7 +1,8 @@
 #pragma once
 
-#include <sstream>
+#include <cstdint>
 #include <iomanip>
+#include <sstream>
 
 struct PciAddress {
   typedef unsigned short domain_type;
@@ -14,6 +15,13 @@ struct PciAddress {
   dev_type dev_;
   func_type func_;
 
+  /* all fields packed into one integer, for use as a hash key
+   */
+  uint64_t packed() const noexcept {
+    return uint64_t(domain_) << 24 | uint64_t(bus_) << 16 |
+           uint64_t(dev_) << 8 | uint64_t(func_);
+  }
+
   bool operator==(const PciAddress &rhs) const noexcept {
     return rhs.domain_ == domain_ && rhs.bus_ == bus_ && rhs.dev_ == dev_ &&
            rhs.func_ == func_;
@@ -0,0 +1,489 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <map>
+#include <ostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "affinity.hpp"
+#include "graph.hpp"
+#include "mat2d.hpp"
+
+namespace hwgraph {
+
+/* what a GPU subset maximizes
+ */
+enum class Objective {
+  MinPair,  // bandwidth of the narrowest pair
+  SumPairs, // total bandwidth over all pairs
+};
+
+/* sets of up to this many candidates are searched exhaustively
+ */
+constexpr size_t SUBSET_EXACT_MAX = 16;
+
+struct Subset {
+  std::vector<Vertex_t> gpus;
+  double score; // the objective, inf for MinPair with fewer than 2 GPUs, -1
+                // if there were fewer than k candidates
+};
+
+/* the objective for the vertices at positions set in bw
+ */
+inline double subset_score(const Mat2D<double> &bw,
+                           const std::vector<int64_t> &set, Objective obj) {
+  double ret = obj == Objective::MinPair
+                   ? std::numeric_limits<double>::infinity()
+                   : 0;
+  for (size_t i = 0; i < set.size(); ++i) {
+    for (size_t j = i + 1; j < set.size(); ++j) {
+      const double b = bw(set[i], set[j]);
+      ret = obj == Objective::MinPair ? std::min(ret, b) : ret + b;
+    }
+  }
+  return ret;
+}
+
+/* best k of n by branch-and-bound over include/exclude decisions in index
+   order, seeded with a known subset
+*/
+class SubsetSearch {
+public:
+  SubsetSearch(const Mat2D<double> &bw, int64_t k, Objective obj,
+               std::vector<int64_t> seed)
+      : bw_(bw), n_(bw.rows()), k_(k), obj_(obj), best_(std::move(seed)),
+        bestScore_(subset_score(bw, best_, obj)) {}
+
+  std::vector<int64_t> run() {
+    chosen_.clear();
+    search(0, obj_ == Objective::MinPair
+                  ? std::numeric_limits<double>::infinity()
+                  : 0);
+    return best_;
+  }
+
+private:
+  /* an upper bound on the score of any completion of chosen_ from
+     candidates [next, n)
+  */
+  double bound(int64_t next, double score) {
+    if (obj_ == Objective::MinPair) {
+      return score; // adding a vertex never widens the narrowest pair
+    }
+
+    // each remaining vertex could add its pairs with chosen_, plus half of
+    // its widest pairs with the other vertices still to be picked
+    const int64_t left = k_ - int64_t(chosen_.size());
+    gain_.clear();
+    for (int64_t v = next; v < n_; ++v) {
+      double g = 0;
+      for (int64_t u : chosen_) {
+        g += bw_(u, v);
+      }
+      others_.clear();
+      for (int64_t u = next; u < n_; ++u) {
+        if (u != v) {
+          others_.push_back(bw_(u, v));
+        }
+      }
+      const int64_t m = std::min<int64_t>(left - 1, others_.size());
+      std::partial_sort(others_.begin(), others_.begin() + m, others_.end(),
+                        std::greater<double>());
+      for (int64_t i = 0; i < m; ++i) {
+        g += others_[i] / 2;
+      }
+      gain_.push_back(g);
+    }
+    std::partial_sort(gain_.begin(), gain_.begin() + left, gain_.end(),
+                      std::greater<double>());
+    for (int64_t i = 0; i < left; ++i) {
+      score += gain_[i];
+    }
+    return score;
+  }
+
+  void search(int64_t next, double score) {
+    if (int64_t(chosen_.size()) == k_) {
+      if (score > bestScore_) {
+        bestScore_ = score;
+        best_ = chosen_;
+      }
+      return;
+    }
+    if (n_ - next < k_ - int64_t(chosen_.size()) ||
+        bound(next, score) <= bestScore_) {
+      return;
+    }
+
+    // with next
+    double with = score;
+    for (int64_t u : chosen_) {
+      with = obj_ == Objective::MinPair ? std::min(with, bw_(u, next))
+                                        : with + bw_(u, next);
+    }
+    chosen_.push_back(next);
+    search(next + 1, with);
+    chosen_.pop_back();
+
+    // without next
+    search(next + 1, score);
+  }
+
+  const Mat2D<double> &bw_;
+  int64_t n_;
+  int64_t k_;
+  Objective obj_;
+  std::vector<int64_t> best_;
+  double bestScore_;
+  std::vector<int64_t> chosen_;
+  std::vector<double> gain_;
+  std::vector<double> others_;
+};
+
+/* positions of the k vertices in bw that maximize obj. Greedy growth from
+   the widest pair improved by single swaps, then branch-and-bound if there
+   are at most SUBSET_EXACT_MAX vertices. Empty if k is larger than bw
+*/
+inline std::vector<int64_t> best_subset_indices(const Mat2D<double> &bw,
+                                                int64_t k, Objective obj) {
+  const int64_t n = bw.rows();
+  std::vector<int64_t> set;
+  if (k > n || k <= 0) {
+    return set;
+  }
+
+  // greedy: start from the widest pair and add the vertex that scores best
+  std::vector<char> in(n, 0);
+  int64_t a = 0, b = n > 1 ? 1 : 0;
+  for (int64_t i = 0; i < n; ++i) {
+    for (int64_t j = i + 1; j < n; ++j) {
+      if (bw(i, j) > bw(a, b)) {
+        a = i;
+        b = j;
+      }
+    }
+  }
+  set.push_back(a);
+  in[a] = 1;
+  if (k > 1) {
+    set.push_back(b);
+    in[b] = 1;
+  }
+  while (int64_t(set.size()) < k) {
+    int64_t best = -1;
+    double bestScore = 0;
+    for (int64_t v = 0; v < n; ++v) {
+      if (in[v]) {
+        continue;
+      }
+      set.push_back(v);
+      const double s = subset_score(bw, set, obj);
+      set.pop_back();
+      if (best < 0 || s > bestScore) {
+        best = v;
+        bestScore = s;
+      }
+    }
+    set.push_back(best);
+    in[best] = 1;
+  }
+
+  // swap a member for a non-member while that improves the score
+  double score = subset_score(bw, set, obj);
+  for (bool improved = true; improved;) {
+    improved = false;
+    for (int64_t i = 0; i < k; ++i) {
+      for (int64_t v = 0; v < n; ++v) {
+        if (in[v]) {
+          continue;
+        }
+        const int64_t old = set[i];
+        set[i] = v;
+        const double s = subset_score(bw, set, obj);
+        if (s > score) {
+          score = s;
+          in[old] = 0;
+          in[v] = 1;
+          improved = true;
+        } else {
+          set[i] = old;
+        }
+      }
+    }
+  }
+
+  if (n <= int64_t(SUBSET_EXACT_MAX)) {
+    set = SubsetSearch(bw, k, obj, set).run();
+  }
+  std::sort(set.begin(), set.end());
+  return set;
+}
+
+/* the k GPUs in candidates with the best pairwise bandwidth, by the widest
+   path between each pair (Graph::all_pairs)
+*/
+inline Subset best_subset(Graph &g, const std::vector<Vertex_t> &candidates,
+                          size_t k, Objective obj = Objective::MinPair) {
+  const Mat2D<double> bw = g.all_pairs().bandwidth_among(candidates);
+  const std::vector<int64_t> set = best_subset_indices(bw, k, obj);
+  Subset ret;
+  ret.score = set.size() == k ? subset_score(bw, set, obj) : -1;
+  for (int64_t i : set) {
+    ret.gpus.push_back(candidates[i]);
+  }
+  return ret;
+}
+
+/* seconds per byte charged between devices with no path
+ */
+constexpr double UNREACHABLE_COST = 1;
+
+/* seconds per byte between each pair of devices, by the widest path between
+   them. Free between a device and itself
+*/
+inline Mat2D<double> transfer_cost(Graph &g,
+                                   const std::vector<Vertex_t> &devices) {
+  const PairMatrix &pairs = g.all_pairs();
+  Mat2D<double> ret(devices.size(), devices.size());
+  for (size_t i = 0; i < devices.size(); ++i) {
+    for (size_t j = 0; j < devices.size(); ++j) {
+      const double bw = pairs.bandwidth_between(devices[i], devices[j]);
+      if (devices[i] == devices[j]) {
+        ret(i, j) = 0;
+      } else {
+        ret(i, j) = bw > 0 ? 1 / bw : UNREACHABLE_COST;
+      }
+    }
+  }
+  return ret;
+}
+
+/* sum of traffic(i, j) * cost(slot[i], slot[j])
+ */
+inline double mapping_cost(const Mat2D<double> &traffic,
+                           const Mat2D<double> &cost,
+                           const std::vector<int64_t> &slot) {
+  double ret = 0;
+  for (int64_t i = 0; i < traffic.rows(); ++i) {
+    for (int64_t j = 0; j < traffic.cols(); ++j) {
+      ret += traffic(i, j) * cost(slot[i], slot[j]);
+    }
+  }
+  return ret;
+}
+
+/* Pairwise-swap local search for the quadratic assignment of ranks to
+   slots, restarted from random assignments.
+
+   traffic is ranks x ranks and cost is slots x slots, with at least as many
+   slots as ranks. Ranks past traffic.rows() are placeholders with no
+   traffic, so a rank can move to an unused slot by swapping with one
+*/
+class RankSearch {
+public:
+  RankSearch(const Mat2D<double> &traffic, const Mat2D<double> &cost,
+             uint64_t seed)
+      : traffic_(traffic), cost_(cost), ranks_(traffic.rows()),
+        n_(cost.rows()), slot_(n_), rng_(seed) {}
+
+  /* the best assignment found from restarts random starts, at least one
+   */
+  std::vector<int64_t> run(int restarts) {
+    restarts = std::max(restarts, 1);
+    std::vector<int64_t> best;
+    double bestCost = std::numeric_limits<double>::infinity();
+    for (int64_t i = 0; i < n_; ++i) {
+      slot_[i] = i;
+    }
+    for (int r = 0; r < restarts; ++r) {
+      std::shuffle(slot_.begin(), slot_.end(), rng_);
+      descend();
+      const double c = mapping_cost(traffic_, cost_, slot_);
+      if (c < bestCost) {
+        bestCost = c;
+        best = slot_;
+      }
+    }
+    best.resize(ranks_);
+    return best;
+  }
+
+private:
+  double f(int64_t i, int64_t j) const {
+    return i < ranks_ && j < ranks_ ? traffic_(i, j) : 0;
+  }
+  double d(int64_t i, int64_t j) const { return cost_(slot_[i], slot_[j]); }
+
+  /* change in cost from swapping the slots of ranks r and s
+   */
+  double delta(int64_t r, int64_t s) const {
+    const int64_t pr = slot_[r], ps = slot_[s];
+    double ret = (f(r, s) - f(s, r)) * (cost_(ps, pr) - cost_(pr, ps)) +
+                 (f(r, r) - f(s, s)) * (cost_(ps, ps) - cost_(pr, pr));
+    for (int64_t k = 0; k < ranks_; ++k) {
+      if (k == r || k == s) {
+        continue;
+      }
+      const int64_t pk = slot_[k];
+      ret += (f(r, k) - f(s, k)) * (cost_(ps, pk) - cost_(pr, pk)) +
+             (f(k, r) - f(k, s)) * (cost_(pk, ps) - cost_(pk, pr));
+    }
+    return ret;
+  }
+
+  /* take improving swaps until there are none
+   */
+  void descend() {
+    double cost = mapping_cost(traffic_, cost_, slot_);
+    for (bool improved = true; improved;) {
+      improved = false;
+      for (int64_t r = 0; r < ranks_; ++r) {
+        for (int64_t s = r + 1; s < n_; ++s) {
+          // ignore rounding-sized gains, which could swap back and forth
+          const double dc = delta(r, s);
+          if (dc < -1e-12 * cost) {
+            std::swap(slot_[r], slot_[s]);
+            cost += dc;
+            improved = true;
+          }
+        }
+      }
+    }
+  }
+
+  const Mat2D<double> &traffic_;
+  const Mat2D<double> &cost_;
+  int64_t ranks_;
+  int64_t n_;
+  std::vector<int64_t> slot_; // slot of each rank, then of each placeholder
+  std::mt19937_64 rng_;
+};
+
+/* slot for each rank minimizing mapping_cost, from threads searches of
+   restarts starts each, run in parallel. threads 0 uses one per hardware
+   thread. Empty if traffic or cost is not square, or there are fewer slots
+   than ranks
+*/
+inline std::vector<int64_t> map_ranks_indices(const Mat2D<double> &traffic,
+                                              const Mat2D<double> &cost,
+                                              unsigned threads = 0,
+                                              int restarts = 4,
+                                              uint64_t seed = 1) {
+  if (traffic.rows() != traffic.cols() || cost.rows() != cost.cols() ||
+      cost.rows() < traffic.rows()) {
+    return std::vector<int64_t>();
+  }
+  if (threads == 0) {
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+
+  std::vector<std::vector<int64_t>> found(threads);
+  std::vector<std::thread> workers;
+  for (unsigned t = 0; t < threads; ++t) {
+    workers.emplace_back([&, t]() {
+      RankSearch search(traffic, cost, seed + t);
+      found[t] = search.run(restarts);
+    });
+  }
+  for (std::thread &w : workers) {
+    w.join();
+  }
+
+  // lowest cost, then lowest thread, so the answer only depends on the seed
+  // and thread count
+  size_t best = 0;
+  for (size_t t = 1; t < found.size(); ++t) {
+    if (mapping_cost(traffic, cost, found[t]) <
+        mapping_cost(traffic, cost, found[best])) {
+      best = t;
+    }
+  }
+  return found[best];
+}
+
+struct RankMap {
+  std::vector<Vertex_t> devices; // devices[r] is rank r's
+  // mapping_cost in seconds, or -1 if there were too few slots or traffic
+  // was not square
+  double cost;
+};
+
+/* Place the ranks of an N x N traffic matrix (bytes from rank i to rank j)
+   onto slots. Each slot takes one rank; list a device more than once to put
+   more than one rank on it
+*/
+inline RankMap map_ranks(Graph &g, const Mat2D<double> &traffic,
+                         const std::vector<Vertex_t> &slots,
+                         unsigned threads = 0, int restarts = 4,
+                         uint64_t seed = 1) {
+  const Mat2D<double> cost = transfer_cost(g, slots);
+  const std::vector<int64_t> slot =
+      map_ranks_indices(traffic, cost, threads, restarts, seed);
+  RankMap ret;
+  ret.cost = slot.empty() && traffic.rows() ? -1
+                                            : mapping_cost(traffic, cost, slot);
+  for (int64_t s : slot) {
+    ret.devices.push_back(slots[s]);
+  }
+  return ret;
+}
+
+/* Write m as an Open MPI rankfile for host, each rank preceded by a comment
+   naming its device. Each rank is bound to the least-used of the cores
+   closest to its device (closest_cores). Without Core vertices, ranks are
+   bound to cores of the package their device is closest to, numbering cores
+   within a package in rank order
+*/
+inline void write_rankfile(std::ostream &os, Graph &g, const RankMap &m,
+                           const std::string &host) {
+  std::map<int64_t, int64_t> used;     // cores handed out per package
+  std::map<Vertex_t, int64_t> coreUses; // ranks bound to each core vertex
+  for (size_t r = 0; r < m.devices.size(); ++r) {
+    const Vertex_t &v = m.devices[r];
+    Vertex_t core;
+    for (const Vertex_t &c : closest_cores(g, v)) {
+      if (!core || coreUses[c] < coreUses[core]) {
+        core = c;
+      }
+    }
+    if (core) {
+      ++coreUses[core];
+    }
+    const Vertex_t &from = core ? core : v;
+    Vertex_t pkg = Vertex::is_package(from)
+                       ? from
+                       : g.shortest_path(from, Vertex::is_package).second;
+
+    os << "# rank " << r << ": " << v->name_;
+    if (const PciAddress *addr = v->pci_address()) {
+      os << " " << addr->str();
+    }
+    os << "\n";
+
+    os << "rank " << r << "=" << host << " slot=";
+    if (pkg) {
+      const int64_t socket = pkg->type_ == Vertex::Type::Intel
+                                 ? pkg->data_.intel.idx
+                                 : pkg->data_.ppc_.idx;
+      if (core) {
+        os << socket << ":" << core->data_.core.pkgIdx;
+      } else {
+        os << socket << ":" << used[socket]++;
+      }
+    } else if (core) {
+      os << core->data_.core.idx; // no package: the core's logical index
+    } else {
+      os << used[-1]++; // no package: the next logical core
+    }
+    os << "\n";
+  }
+}
+
+} // namespace hwgraph
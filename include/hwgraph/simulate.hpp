@@ -0,0 +1,286 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <vector>
+
+#include "csr.hpp"
+#include "fair_share.hpp"
+
+namespace hwgraph {
+
+/* a transfer for Simulator::run
+ */
+struct Transfer {
+  uint32_t src;
+  uint32_t dst;
+  EdgePath path;                // from src to dst. empty: routed
+  double bytes;                 // size
+  double start;                 // earliest start, in seconds
+  std::vector<uint32_t> after;  // transfers that must finish first
+};
+
+/* the rate through an edge from time on, in bytes/s
+ */
+struct Utilization {
+  double time;
+  double forward;  // from edge_u to edge_v
+  double backward; // from edge_v to edge_u
+};
+
+struct SimResult {
+  std::vector<double> start;  // when each transfer started, or inf if never
+  std::vector<double> finish; // when each transfer finished, or inf if never
+  // per CsrGraph edge id, a sample each time the edge's rates change. Empty
+  // unless the run recorded utilization
+  std::vector<std::vector<Utilization>> utilization;
+};
+
+/* Discrete-event simulation of transfers over a CsrGraph.
+
+   Running transfers share links max-min fairly (see FairShare), and rates
+   are re-solved whenever a transfer starts or finishes. A transfer starts
+   at its start time or when the last transfer it is after finishes, if that
+   is later. Transfers with no route, or only routes through edges with no
+   bandwidth model, never finish, and neither does anything after them.
+
+   Events go through one binary heap. A finish event is invalidated rather
+   than removed when its transfer's rate changes, and transfers whose rate
+   did not change keep theirs, so the heap holds at most one live finish
+   event per running transfer plus the stale ones. A Simulator keeps its
+   buffers between runs, so the event loop does not allocate once they have
+   grown, apart from appending utilization samples.
+*/
+class Simulator {
+public:
+  explicit Simulator(const CsrGraph &g) : g_(g), share_(g) {}
+
+  /* The reference is valid until the next run
+   */
+  const SimResult &run(const std::vector<Transfer> &transfers,
+                       Routing routing = Routing::Widest,
+                       bool recordUtilization = false) {
+    const double inf = std::numeric_limits<double>::infinity();
+    const uint32_t n = transfers.size();
+    init(transfers, routing);
+
+    result_.start.assign(n, inf);
+    result_.finish.assign(n, inf);
+    result_.utilization.resize(recordUtilization ? g_.num_edges() : 0);
+    for (auto &u : result_.utilization) {
+      u.clear();
+    }
+    linkRate_.assign(2 * g_.num_edges(), 0);
+
+    events_.clear();
+    for (uint32_t i = 0; i < n; ++i) {
+      if (pending_[i] == 0) {
+        push(transfers[i].start, i, Kind::Start);
+      }
+    }
+
+    double now = 0;
+    while (!events_.empty()) {
+      const double t = events_.front().time;
+
+      // progress since the last event
+      for (uint32_t i : running_) {
+        remaining_[i] -= rate_[i] * (t - now);
+      }
+      now = t;
+
+      // everything that happens at t, before rates are re-solved
+      bool changed = false;
+      while (!events_.empty() && events_.front().time <= t) {
+        std::pop_heap(events_.begin(), events_.end(), std::greater<Event>());
+        const Event ev = events_.back();
+        events_.pop_back();
+
+        switch (ev.kind) {
+        case Kind::Start: {
+          const Transfer &tr = transfers[ev.transfer];
+          result_.start[ev.transfer] = t;
+          if (tr.bytes <= 0 || tr.src == tr.dst) {
+            finish(ev.transfer, t, transfers);
+          } else if (!flows_[ev.transfer].path.empty()) {
+            slot_[ev.transfer] = running_.size();
+            running_.push_back(ev.transfer);
+            changed = true;
+          }
+          break;
+        }
+        case Kind::Finish:
+          if (ev.stamp == stamp_[ev.transfer]) {
+            // swap out of running_
+            const uint32_t s = slot_[ev.transfer];
+            running_[s] = running_.back();
+            slot_[running_[s]] = s;
+            running_.pop_back();
+            finish(ev.transfer, t, transfers);
+            changed = true;
+          }
+          break;
+        }
+      }
+
+      if (changed) {
+        const std::vector<double> &rates = share_.solve(flows_, running_);
+        for (uint32_t k = 0; k < running_.size(); ++k) {
+          const uint32_t i = running_[k];
+          if (rates[k] == rate_[i]) {
+            continue; // its finish event still holds
+          }
+          rate_[i] = rates[k];
+          ++stamp_[i];
+          if (rates[k] > 0) {
+            push(t + std::max(remaining_[i], 0.0) / rates[k], i, Kind::Finish,
+                 stamp_[i]);
+          }
+        }
+        if (recordUtilization) {
+          record(t);
+        }
+      }
+    }
+    return result_;
+  }
+
+  /* the most events queued at once in any run so far, rounded up to the
+     event buffer's capacity
+  */
+  size_t event_capacity() const { return events_.capacity(); }
+
+private:
+  enum class Kind { Start, Finish };
+
+  struct Event {
+    double time;
+    uint32_t transfer;
+    Kind kind;
+    uint32_t stamp; // Finish: stamp_[transfer] when pushed
+    bool operator>(const Event &rhs) const { return time > rhs.time; }
+  };
+
+  void push(double time, uint32_t transfer, Kind kind, uint32_t stamp = 0) {
+    Event e = {time, transfer, kind, stamp};
+    events_.push_back(e);
+    std::push_heap(events_.begin(), events_.end(), std::greater<Event>());
+  }
+
+  /* route transfers and index their dependencies
+   */
+  void init(const std::vector<Transfer> &transfers, Routing routing) {
+    const uint32_t n = transfers.size();
+    flows_.resize(n);
+    for (uint32_t i = 0; i < n; ++i) {
+      flows_[i].src = transfers[i].src;
+      flows_[i].dst = transfers[i].dst;
+      flows_[i].path = transfers[i].path;
+    }
+    share_.route(flows_, routing);
+
+    // transfers after i are next_[nextStart_[i], nextStart_[i+1])
+    pending_.resize(n);
+    nextStart_.assign(n + 1, 0);
+    for (uint32_t i = 0; i < n; ++i) {
+      pending_[i] = transfers[i].after.size();
+      for (uint32_t d : transfers[i].after) {
+        ++nextStart_[d + 1];
+      }
+    }
+    for (uint32_t i = 0; i < n; ++i) {
+      nextStart_[i + 1] += nextStart_[i];
+    }
+    next_.resize(nextStart_[n]);
+    pos_.assign(nextStart_.begin(), nextStart_.end() - 1);
+    for (uint32_t i = 0; i < n; ++i) {
+      for (uint32_t d : transfers[i].after) {
+        next_[pos_[d]++] = i;
+      }
+    }
+
+    remaining_.resize(n);
+    for (uint32_t i = 0; i < n; ++i) {
+      remaining_[i] = transfers[i].bytes;
+    }
+    rate_.assign(n, 0);
+    stamp_.assign(n, 0);
+    slot_.resize(n);
+    running_.clear();
+  }
+
+  void finish(uint32_t i, double t, const std::vector<Transfer> &transfers) {
+    result_.finish[i] = t;
+    remaining_[i] = 0;
+    rate_[i] = 0;
+    for (uint32_t j = nextStart_[i]; j < nextStart_[i + 1]; ++j) {
+      const uint32_t d = next_[j];
+      if (--pending_[d] == 0) {
+        push(std::max(transfers[d].start, t), d, Kind::Start);
+      }
+    }
+  }
+
+  /* append a utilization sample at t for each edge whose rates changed
+   */
+  void record(double t) {
+    newRate_.assign(linkRate_.size(), 0);
+    for (uint32_t i : running_) {
+      uint32_t v = flows_[i].src;
+      for (uint32_t e : flows_[i].path) {
+        newRate_[share_.link(e, v)] += rate_[i];
+        v = g_.other_vertex(e, v);
+      }
+    }
+    for (uint32_t e = 0; e < g_.num_edges(); ++e) {
+      const double fwd = newRate_[2 * e], bwd = newRate_[2 * e + 1];
+      std::vector<Utilization> &u = result_.utilization[e];
+      if (fwd != linkRate_[2 * e] || bwd != linkRate_[2 * e + 1]) {
+        if (!u.empty() && u.back().time == t) {
+          u.back().forward = fwd;
+          u.back().backward = bwd;
+        } else {
+          Utilization s = {t, fwd, bwd};
+          u.push_back(s);
+        }
+      }
+    }
+    linkRate_.swap(newRate_);
+  }
+
+  const CsrGraph &g_;
+  FairShare share_;
+  SimResult result_;
+
+  std::vector<FairFlow> flows_; // routed transfers
+  std::vector<Event> events_;   // a min-heap on time
+  std::vector<uint32_t> running_;
+
+  // per transfer
+  std::vector<uint32_t> pending_; // unfinished transfers it is after
+  std::vector<double> remaining_; // bytes
+  std::vector<double> rate_;      // bytes/s
+  std::vector<uint32_t> stamp_;   // bumped when rate_ changes
+  std::vector<uint32_t> slot_;    // position in running_
+
+  std::vector<uint32_t> nextStart_;
+  std::vector<uint32_t> next_;
+  std::vector<uint32_t> pos_;
+
+  std::vector<double> linkRate_; // per FairShare link, at the last sample
+  std::vector<double> newRate_;
+};
+
+/* simulate transfers over g. See Simulator
+ */
+inline SimResult simulate(const CsrGraph &g,
+                          const std::vector<Transfer> &transfers,
+                          Routing routing = Routing::Widest,
+                          bool recordUtilization = false) {
+  Simulator sim(g);
+  return sim.run(transfers, routing, recordUtilization);
+}
+
+} // namespace hwgraph
@@ -0,0 +1,317 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "graph.hpp"
+
+namespace hwgraph {
+
+/* Identifies the machine state a snapshot was taken in.
+   A snapshot is only reused if both fields match
+*/
+struct SnapshotKey {
+  char bootId[40];      // /proc/sys/kernel/random/boot_id
+  uint64_t fingerprint; // cheap hash of the visible hardware
+
+  SnapshotKey() : fingerprint(0) { std::memset(bootId, 0, sizeof(bootId)); }
+
+  bool operator==(const SnapshotKey &rhs) const noexcept {
+    return fingerprint == rhs.fingerprint &&
+           0 == std::strncmp(bootId, rhs.bootId, sizeof(bootId));
+  }
+
+  /* key for the running machine.
+     The fingerprint covers the CPU count and the PCI devices in sysfs, which
+     is a directory listing rather than a full discovery
+  */
+  static SnapshotKey current() {
+    SnapshotKey key;
+
+    std::ifstream bootId("/proc/sys/kernel/random/boot_id");
+    std::string id;
+    if (bootId >> id) {
+      std::strncpy(key.bootId, id.c_str(), sizeof(key.bootId) - 1);
+    }
+
+    std::vector<std::string> devices;
+    if (DIR *dir = opendir("/sys/bus/pci/devices")) {
+      while (struct dirent *ent = readdir(dir)) {
+        if (ent->d_name[0] != '.') {
+          devices.push_back(ent->d_name);
+        }
+      }
+      closedir(dir);
+    }
+    std::sort(devices.begin(), devices.end());
+
+    // FNV-1a
+    uint64_t h = 14695981039346656037ull;
+    auto mix = [&](const char *p, size_t n) {
+      for (size_t i = 0; i < n; ++i) {
+        h = (h ^ uint8_t(p[i])) * 1099511628211ull;
+      }
+    };
+    const long cpus = sysconf(_SC_NPROCESSORS_CONF);
+    mix(reinterpret_cast<const char *>(&cpus), sizeof(cpus));
+    for (const auto &d : devices) {
+      mix(d.c_str(), d.size() + 1);
+    }
+    key.fingerprint = h;
+    return key;
+  }
+};
+
+/* On-disk layout: header, vertex records, edge records, then vertex names.
+   Records hold the Vertex::Data / Edge::Data unions verbatim, so a snapshot
+   is only readable by a build with the same layout and byte order
+*/
+struct SnapshotHeader {
+  char magic[8];
+  uint32_t formatVersion;
+  uint32_t vertexDataSize; // sizeof(Vertex::Data) of the writer
+  uint32_t edgeDataSize;   // sizeof(Edge::Data) of the writer
+  uint32_t methods;        // the DiscoveryMethod the graph was made with
+  SnapshotKey key;
+  uint64_t numVertices;
+  uint64_t numEdges;
+  uint64_t vertexOffset;
+  uint64_t edgeOffset;
+  uint64_t nameOffset;
+  uint64_t nameBytes;
+};
+
+struct SnapshotVertex {
+  Vertex::Type type;
+  uint32_t nameOffset; // from SnapshotHeader::nameOffset
+  uint32_t nameLength;
+  uint32_t reserved;
+  Vertex::Data data;
+};
+
+struct SnapshotEdge {
+  Edge::Type type;
+  uint32_t u; // index of vertex record
+  uint32_t v;
+  uint32_t reserved;
+  double latency; // Edge::latency_
+  Edge::Data data;
+};
+
+/* bump when the layout of the header or records changes
+ */
+static constexpr uint32_t SNAPSHOT_FORMAT_VERSION = 1;
+
+/* the last Vertex::Type and Edge::Type a snapshot may hold
+ */
+static constexpr Vertex::Type SNAPSHOT_LAST_VERTEX_TYPE =
+    Vertex::Type::Coprocessor;
+static constexpr Edge::Type SNAPSHOT_LAST_EDGE_TYPE = Edge::Type::Onchip;
+
+inline void snapshot_magic(char *magic) { std::memcpy(magic, "HWGSNAP", 8); }
+
+/* Write g, discovered with methods, to path. The file is written beside
+   path and renamed into place, so concurrent readers never see a partial
+   snapshot
+*/
+inline void write_snapshot(const Graph &g, const std::string &path,
+                           const SnapshotKey &key = SnapshotKey::current(),
+                           uint32_t methods = 0) {
+  std::vector<Vertex_t> vertices(g.vertices().begin(), g.vertices().end());
+  std::map<Vertex_t, uint32_t> index;
+  std::string names;
+
+  std::vector<SnapshotVertex> vrecs(vertices.size());
+  for (uint32_t i = 0; i < vertices.size(); ++i) {
+    index[vertices[i]] = i;
+    SnapshotVertex &r = vrecs[i];
+    std::memset(&r, 0, sizeof(r));
+    r.type = vertices[i]->type_;
+    r.nameOffset = names.size();
+    r.nameLength = vertices[i]->name_.size();
+    std::memcpy(&r.data, &vertices[i]->data_, sizeof(r.data));
+    names += vertices[i]->name_;
+  }
+
+  std::vector<SnapshotEdge> erecs;
+  for (const auto &e : g.edges()) {
+    SnapshotEdge r;
+    std::memset(&r, 0, sizeof(r));
+    r.type = e->type_;
+    r.u = index.at(e->u_);
+    r.v = index.at(e->v_);
+    r.latency = e->latency_;
+    std::memcpy(&r.data, &e->data_, sizeof(r.data));
+    erecs.push_back(r);
+  }
+
+  SnapshotHeader h = SnapshotHeader();
+  snapshot_magic(h.magic);
+  h.formatVersion = SNAPSHOT_FORMAT_VERSION;
+  h.vertexDataSize = sizeof(Vertex::Data);
+  h.edgeDataSize = sizeof(Edge::Data);
+  h.methods = methods;
+  h.key = key;
+  h.numVertices = vrecs.size();
+  h.numEdges = erecs.size();
+  h.vertexOffset = sizeof(h);
+  h.edgeOffset = h.vertexOffset + vrecs.size() * sizeof(SnapshotVertex);
+  h.nameOffset = h.edgeOffset + erecs.size() * sizeof(SnapshotEdge);
+  h.nameBytes = names.size();
+
+  const std::string tmp = path + ".tmp." + std::to_string(getpid());
+  std::ofstream os(tmp, std::ios::binary | std::ios::trunc);
+  os.write(reinterpret_cast<const char *>(&h), sizeof(h));
+  os.write(reinterpret_cast<const char *>(vrecs.data()),
+           vrecs.size() * sizeof(SnapshotVertex));
+  os.write(reinterpret_cast<const char *>(erecs.data()),
+           erecs.size() * sizeof(SnapshotEdge));
+  os.write(names.data(), names.size());
+  os.close();
+  if (!os || 0 != std::rename(tmp.c_str(), path.c_str())) {
+    std::remove(tmp.c_str());
+    throw std::runtime_error("couldn't write snapshot " + path);
+  }
+}
+
+/* A read-only view of a snapshot file mapped into memory.
+   Records are used in place; graph() builds a Graph from them
+*/
+class Snapshot {
+public:
+  /* map path. throws if it can't be read or is not a compatible snapshot
+   */
+  explicit Snapshot(const std::string &path) : base_(nullptr), size_(0) {
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      throw std::runtime_error("couldn't open snapshot " + path);
+    }
+    struct stat st;
+    if (0 == fstat(fd, &st) && size_t(st.st_size) >= sizeof(SnapshotHeader)) {
+      size_ = st.st_size;
+      void *p = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+      base_ = (p == MAP_FAILED) ? nullptr : static_cast<const char *>(p);
+    }
+    close(fd);
+    if (!base_) {
+      throw std::runtime_error("couldn't map snapshot " + path);
+    }
+
+    char magic[8];
+    snapshot_magic(magic);
+    const SnapshotHeader &h = header();
+    if (0 != std::memcmp(h.magic, magic, sizeof(magic)) ||
+        h.formatVersion != SNAPSHOT_FORMAT_VERSION ||
+        h.vertexDataSize != sizeof(Vertex::Data) ||
+        h.edgeDataSize != sizeof(Edge::Data) ||
+        h.vertexOffset != sizeof(SnapshotHeader) ||
+        h.edgeOffset !=
+            h.vertexOffset + h.numVertices * sizeof(SnapshotVertex) ||
+        h.nameOffset != h.edgeOffset + h.numEdges * sizeof(SnapshotEdge) ||
+        h.nameOffset + h.nameBytes > size_) {
+      unmap();
+      throw std::runtime_error("incompatible snapshot " + path);
+    }
+  }
+
+  Snapshot(Snapshot &&other) noexcept
+      : base_(other.base_), size_(other.size_) {
+    other.base_ = nullptr;
+    other.size_ = 0;
+  }
+  Snapshot(const Snapshot &other) = delete;
+  Snapshot &operator=(const Snapshot &other) = delete;
+
+  ~Snapshot() { unmap(); }
+
+  const SnapshotHeader &header() const {
+    return *reinterpret_cast<const SnapshotHeader *>(base_);
+  }
+
+  /* false if the snapshot was taken on a different boot or hardware
+   */
+  bool matches(const SnapshotKey &key) const { return header().key == key; }
+
+  /* the methods passed to write_snapshot()
+   */
+  uint32_t methods() const { return header().methods; }
+
+  uint64_t num_vertices() const { return header().numVertices; }
+  uint64_t num_edges() const { return header().numEdges; }
+
+  const SnapshotVertex &vertex(uint64_t i) const {
+    return reinterpret_cast<const SnapshotVertex *>(
+        base_ + header().vertexOffset)[i];
+  }
+  const SnapshotEdge &edge(uint64_t i) const {
+    return reinterpret_cast<const SnapshotEdge *>(base_ +
+                                                  header().edgeOffset)[i];
+  }
+  /* throws if the name is outside the snapshot's names
+   */
+  std::string name(uint64_t i) const {
+    const SnapshotVertex &v = vertex(i);
+    if (uint64_t(v.nameOffset) + v.nameLength > header().nameBytes) {
+      throw std::runtime_error("snapshot vertex name out of bounds");
+    }
+    return std::string(base_ + header().nameOffset + v.nameOffset,
+                       v.nameLength);
+  }
+
+  /* throws if a record is corrupt
+   */
+  Graph graph() const {
+    Graph g;
+    std::vector<Vertex_t> vertices(num_vertices());
+    for (uint64_t i = 0; i < num_vertices(); ++i) {
+      const SnapshotVertex &r = vertex(i);
+      if (uint32_t(r.type) > uint32_t(SNAPSHOT_LAST_VERTEX_TYPE)) {
+        throw std::runtime_error("bad snapshot vertex type");
+      }
+      vertices[i] = std::make_shared<Vertex>(r.type);
+      vertices[i]->name_ = name(i);
+      std::memcpy(&vertices[i]->data_, &r.data, sizeof(r.data));
+      g.insert_vertex(vertices[i]);
+    }
+    for (uint64_t i = 0; i < num_edges(); ++i) {
+      const SnapshotEdge &r = edge(i);
+      if (r.u >= num_vertices() || r.v >= num_vertices()) {
+        throw std::runtime_error("snapshot edge refers to missing vertex");
+      }
+      if (uint32_t(r.type) > uint32_t(SNAPSHOT_LAST_EDGE_TYPE)) {
+        throw std::runtime_error("bad snapshot edge type");
+      }
+      auto e = std::make_shared<Edge>(r.type);
+      e->latency_ = r.latency;
+      std::memcpy(&e->data_, &r.data, sizeof(r.data));
+      g.join(vertices[r.u], vertices[r.v], e);
+    }
+    return g;
+  }
+
+private:
+  void unmap() {
+    if (base_) {
+      munmap(const_cast<char *>(base_), size_);
+      base_ = nullptr;
+    }
+  }
+
+  const char *base_;
+  size_t size_;
+};
+
+} // namespace hwgraph
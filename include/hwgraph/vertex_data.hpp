@@ -1,7 +1,11 @@
 #pragma once
 
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
 #include <iomanip>
 #include <sstream>
+#include <string>
 
 #include "config.hpp"
 #include "pci_address.hpp"
@@ -12,6 +16,118 @@ inline std::string hex_str(unsigned short u) {
   return ss.str();
 }
 
+/* CPUs and NUMA nodes close to a vertex, by OS index as in hwloc cpusets and
+   nodesets. All zero if unknown
+*/
+struct Locality {
+  enum : unsigned { MAX_CPUS = 1024, MAX_NODES = 256 };
+  uint64_t cpus[MAX_CPUS / 64];
+  uint64_t nodes[MAX_NODES / 64];
+
+  bool has_cpu(unsigned i) const noexcept {
+    return i < MAX_CPUS && (cpus[i / 64] >> (i % 64)) & 1;
+  }
+  bool has_node(unsigned i) const noexcept {
+    return i < MAX_NODES && (nodes[i / 64] >> (i % 64)) & 1;
+  }
+  void add_cpu(unsigned i) noexcept {
+    if (i < MAX_CPUS) {
+      cpus[i / 64] |= uint64_t(1) << (i % 64);
+    }
+  }
+  void add_node(unsigned i) noexcept {
+    if (i < MAX_NODES) {
+      nodes[i / 64] |= uint64_t(1) << (i % 64);
+    }
+  }
+
+  bool empty() const noexcept {
+    for (uint64_t w : cpus) {
+      if (w) {
+        return false;
+      }
+    }
+    for (uint64_t w : nodes) {
+      if (w) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  /* true if every CPU in this is also in other
+   */
+  bool cpus_within(const Locality &other) const noexcept {
+    for (unsigned i = 0; i < MAX_CPUS / 64; ++i) {
+      if (cpus[i] & ~other.cpus[i]) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  /* the lowest NUMA node, or -1 if there are none
+   */
+  int first_node() const noexcept {
+    for (unsigned i = 0; i < MAX_NODES; ++i) {
+      if (has_node(i)) {
+        return i;
+      }
+    }
+    return -1;
+  }
+
+  /* a mask as a hex string, e.g. "0xc" for CPUs 2 and 3
+   */
+  static std::string mask_str(const uint64_t *words, size_t n) {
+    std::stringstream ss;
+    ss << "0x" << std::hex;
+    bool leading = true;
+    for (size_t i = n; i-- > 0;) {
+      if (leading) {
+        if (words[i] || i == 0) {
+          ss << words[i];
+          leading = false;
+        }
+      } else {
+        ss << std::setw(16) << std::setfill('0') << words[i];
+      }
+    }
+    return ss.str();
+  }
+
+  /* parse a mask_str() into words. false if it is not one
+   */
+  static bool mask_from_str(const std::string &s, uint64_t *words, size_t n) {
+    if (s.size() < 3 || s.compare(0, 2, "0x") != 0 ||
+        s.size() - 2 > 16 * n) {
+      return false;
+    }
+    std::fill(words, words + n, 0);
+    size_t digit = 0;
+    for (size_t i = s.size(); i-- > 2; ++digit) {
+      const char c = s[i];
+      uint64_t d;
+      if (c >= '0' && c <= '9') {
+        d = c - '0';
+      } else if (c >= 'a' && c <= 'f') {
+        d = c - 'a' + 10;
+      } else if (c >= 'A' && c <= 'F') {
+        d = c - 'A' + 10;
+      } else {
+        return false;
+      }
+      words[digit / 16] |= d << (4 * (digit % 16));
+    }
+    return true;
+  }
+
+  std::string str() const {
+    return "{cpus: " + mask_str(cpus, MAX_CPUS / 64) +
+           ", nodes: " + mask_str(nodes, MAX_NODES / 64) + "}";
+  }
+};
+
 struct PciDeviceData {
   PciAddress addr;
   unsigned short classId;
@@ -66,6 +182,7 @@ struct IntelData {
   int modelNumber;
   int familyNumber;
   int stepping;
+  Locality locality;
 
   std::string str() const {
     std::string s = "{";
@@ -74,7 +191,8 @@ struct IntelData {
     s += "vendor: " + std::string(vendor) + ", ";
     s += "modelNumber: " + std::to_string(modelNumber) + ", ";
     s += "familyNumber: " + std::to_string(familyNumber) + ", ";
-    s += "stepping: " + std::to_string(stepping);
+    s += "stepping: " + std::to_string(stepping) + ", ";
+    s += "locality: " + locality.str();
     s += "}";
     return s;
   }
@@ -84,13 +202,101 @@ struct PpcData {
   unsigned idx; // hwloc index
   char model[hwgraph::MAX_STR];
   int revision;
+  Locality locality;
 
   std::string str() const {
     std::string s = "{";
     s += "idx: " + std::to_string(idx) + ", ";
     s += "model: " + std::string(model) + ", ";
-    s += "revision: " + std::to_string(revision);
+    s += "revision: " + std::to_string(revision) + ", ";
+    s += "locality: " + locality.str();
+    s += "}";
+    return s;
+  }
+};
+
+struct NumaNodeData {
+  unsigned idx;    // OS index
+  uint64_t memory; // bytes of local memory, 0 if unknown
+  Locality locality;
+
+  std::string str() const {
+    std::string s = "{";
+    s += "idx: " + std::to_string(idx) + ", ";
+    s += "memory: " + std::to_string(memory) + ", ";
+    s += "locality: " + locality.str();
+    s += "}";
+    return s;
+  }
+};
+
+struct L3Data {
+  unsigned idx; // hwloc logical index
+  uint64_t size; // bytes
+  Locality locality;
+
+  std::string str() const {
+    std::string s = "{";
+    s += "idx: " + std::to_string(idx) + ", ";
+    s += "size: " + std::to_string(size) + ", ";
+    s += "locality: " + locality.str();
+    s += "}";
+    return s;
+  }
+};
+
+struct CoreData {
+  unsigned idx;    // hwloc logical index
+  unsigned pkgIdx; // logical index within its package, as in rankfiles
+  Locality locality; // its hardware threads and NUMA nodes
+
+  std::string str() const {
+    std::string s = "{";
+    s += "idx: " + std::to_string(idx) + ", ";
+    s += "pkgIdx: " + std::to_string(pkgIdx) + ", ";
+    s += "locality: " + locality.str();
     s += "}";
     return s;
   }
-};
\ No newline at end of file
+};
+
+/* A PCI device hwloc found OS devices for: a NIC, a storage controller or a
+   co-processor
+*/
+struct OsDeviceData {
+  PciDeviceData pciDev;
+  char names[hwgraph::MAX_STR]; // OS devices, e.g. "ib0,mlx5_0" or "nvme0n1"
+
+  /* append an OS device name, unless it is already there or doesn't fit
+   */
+  void add_name(const char *name) {
+    const size_t n = std::strlen(names);
+    const size_t len = std::strlen(name);
+    if (has_name(name) || n + (n ? 1 : 0) + len >= hwgraph::MAX_STR) {
+      return;
+    }
+    if (n) {
+      names[n] = ',';
+    }
+    std::memcpy(names + n + (n ? 1 : 0), name, len + 1);
+  }
+
+  bool has_name(const std::string &name) const {
+    std::stringstream ss(names);
+    std::string s;
+    while (std::getline(ss, s, ',')) {
+      if (s == name) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  std::string str() const {
+    std::string s = "{";
+    s += "pci_dev: " + pciDev.str() + ", ";
+    s += "names: " + std::string(names);
+    s += "}";
+    return s;
+  }
+};
@@ -1,6 +1,7 @@
 #include <argparse/argparse.hpp>
 
 #include "hwgraph/hwgraph.hpp"
+#include "hwgraph/json.hpp"
 
 using namespace hwgraph;
 
@@ -9,8 +10,17 @@ int main(int argc, char **argv) {
   bool modeText = true;
   bool modeJson = false;
   bool modeDot = false;
+  std::string xmlPath;
   p.add_flag(modeJson, "--json", "-j")->help("JSON output");
   p.add_flag(modeDot, "--dot", "-d")->help("Graphviz output");
+  std::string recordPath;
+  std::string replayPath;
+  p.add_option(xmlPath, "--xml", "-x")
+      ->help("discover from an hwloc XML export instead of this machine");
+  p.add_option(recordPath, "--nvml-record")
+      ->help("save every NVML answer to a file");
+  p.add_option(replayPath, "--nvml-replay")
+      ->help("answer NVML queries from a --nvml-record file");
   if (!p.parse(argc, argv)) {
     std::cerr << p.help();
     exit(EXIT_FAILURE);
@@ -21,13 +31,35 @@ int main(int argc, char **argv) {
   }
 
   DiscoveryMethod methods = available_methods();
-  Graph g = make_graph(methods);
+  hwloc::Topology topo = xmlPath.empty()
+                             ? hwloc::Topology()
+                             : hwloc::Topology::from_xml(xmlPath);
+  if (!xmlPath.empty()) {
+    methods = DiscoveryMethod::Hwloc;
+  }
+
+  Graph g;
+  if (!replayPath.empty()) {
+    nvml::ReplayBackend nvml(replayPath);
+    g = make_graph(methods | DiscoveryMethod::Nvml, topo, nvml);
+  } else if (!recordPath.empty()) {
+#if HWGRAPH_USE_NVML == 1
+    nvml::LiveBackend live;
+    nvml::RecordingBackend nvml(live);
+    g = make_graph(methods | DiscoveryMethod::Nvml, topo, nvml);
+    nvml.recording().write(recordPath);
+#else
+    std::cerr << "--nvml-record: built without NVML\n";
+    exit(EXIT_FAILURE);
+#endif
+  } else {
+    g = make_graph(methods, topo);
+  }
 
   if (modeDot) {
     std::cout << g.dot_str();
   } else if (modeJson) {
-    std::cerr << "json output not supported\n";
-    exit(EXIT_FAILURE);
+    json::write(std::cout, g);
   } else if (modeText) {
     std::cout << "Intel CPUs:\n";
     auto is_intel = [](Vertex_t v) { return v->type_ == Vertex::Type::Intel; };
@@ -48,7 +80,7 @@ int main(int argc, char **argv) {
 
     for (auto &src : cpus) {
       for (auto &dst : gpus) {
-        Path path = g.max_path(src, dst, path_bandwidth);
+        Path path = g.widest_path(src, dst);
 
         for (const Edge_t &e : path) {
           std::cout << e->str() << "\n";
@@ -0,0 +1,23 @@
+#include "count_allocs.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+// replace the global allocation functions so tests can check that a code
+// path does not allocate
+
+static std::atomic<size_t> numAllocations(0);
+
+size_t num_allocations() { return numAllocations; }
+
+void *operator new(size_t n) {
+  ++numAllocations;
+  if (void *p = std::malloc(n ? n : 1)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete(void *p, size_t) noexcept { std::free(p); }
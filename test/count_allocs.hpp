@@ -0,0 +1,7 @@
+#pragma once
+
+#include <cstddef>
+
+/* number of times the global operator new has been called in this process
+ */
+size_t num_allocations();
@@ -0,0 +1,92 @@
+/* A stand-in for libnvidia-ml.so.1 on hosts without an NVIDIA driver.
+
+   It is built with the same soname as the driver library, so a test linked
+   against it loads this instead of the real NVML. It reports no GPUs and
+   counts nvmlInit() / nvmlShutdown() so tests can check the session
+   lifecycle. Calls made while NVML is not initialized fail like the real
+   library does.
+*/
+
+#include <nvml.h>
+
+namespace {
+int inits = 0;
+int shutdowns = 0;
+int refs = 0;
+} // namespace
+
+extern "C" {
+
+int hwgraph_nvml_stub_inits() { return inits; }
+int hwgraph_nvml_stub_shutdowns() { return shutdowns; }
+
+nvmlReturn_t nvmlInit(void) {
+  ++inits;
+  ++refs;
+  return NVML_SUCCESS;
+}
+
+nvmlReturn_t nvmlShutdown(void) {
+  if (refs == 0) {
+    return NVML_ERROR_UNINITIALIZED;
+  }
+  ++shutdowns;
+  --refs;
+  return NVML_SUCCESS;
+}
+
+const char *nvmlErrorString(nvmlReturn_t result) {
+  switch (result) {
+  case NVML_SUCCESS:
+    return "Success";
+  case NVML_ERROR_UNINITIALIZED:
+    return "Uninitialized";
+  case NVML_ERROR_INVALID_ARGUMENT:
+    return "Invalid Argument";
+  default:
+    return "Unknown Error";
+  }
+}
+
+nvmlReturn_t nvmlDeviceGetCount(unsigned int *deviceCount) {
+  if (refs == 0) {
+    return NVML_ERROR_UNINITIALIZED;
+  }
+  *deviceCount = 0;
+  return NVML_SUCCESS;
+}
+
+// there are no devices, so every per-device query has a bad argument
+
+nvmlReturn_t nvmlDeviceGetHandleByIndex(unsigned int, nvmlDevice_t *) {
+  return refs ? NVML_ERROR_INVALID_ARGUMENT : NVML_ERROR_UNINITIALIZED;
+}
+
+nvmlReturn_t nvmlDeviceGetPciInfo(nvmlDevice_t, nvmlPciInfo_t *) {
+  return refs ? NVML_ERROR_INVALID_ARGUMENT : NVML_ERROR_UNINITIALIZED;
+}
+
+nvmlReturn_t nvmlDeviceGetName(nvmlDevice_t, char *, unsigned int) {
+  return refs ? NVML_ERROR_INVALID_ARGUMENT : NVML_ERROR_UNINITIALIZED;
+}
+
+nvmlReturn_t nvmlDeviceGetCudaComputeCapability(nvmlDevice_t, int *, int *) {
+  return refs ? NVML_ERROR_INVALID_ARGUMENT : NVML_ERROR_UNINITIALIZED;
+}
+
+nvmlReturn_t nvmlDeviceGetNvLinkState(nvmlDevice_t, unsigned int,
+                                      nvmlEnableState_t *) {
+  return refs ? NVML_ERROR_INVALID_ARGUMENT : NVML_ERROR_UNINITIALIZED;
+}
+
+nvmlReturn_t nvmlDeviceGetNvLinkVersion(nvmlDevice_t, unsigned int,
+                                        unsigned int *) {
+  return refs ? NVML_ERROR_INVALID_ARGUMENT : NVML_ERROR_UNINITIALIZED;
+}
+
+nvmlReturn_t nvmlDeviceGetNvLinkRemotePciInfo(nvmlDevice_t, unsigned int,
+                                              nvmlPciInfo_t *) {
+  return refs ? NVML_ERROR_INVALID_ARGUMENT : NVML_ERROR_UNINITIALIZED;
+}
+
+} // extern "C"
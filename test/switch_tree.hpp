@@ -0,0 +1,29 @@
+#pragma once
+
+#include "hwgraph/graph.hpp"
+
+/* two GPUs under one switch, and a third directly under the CPU
+ */
+struct SwitchTree {
+  hwgraph::Graph g;
+  hwgraph::Vertex_t cpu;
+  hwgraph::Vertex_t sw;
+  hwgraph::Vertex_t gpu0;
+  hwgraph::Vertex_t gpu1;
+  hwgraph::Vertex_t gpu2;
+  hwgraph::Edge_t up; // cpu to sw
+
+  SwitchTree()
+      : cpu(std::make_shared<hwgraph::Vertex>()),
+        sw(std::make_shared<hwgraph::Vertex>()),
+        gpu0(hwgraph::Vertex::new_gpu("gpu0")),
+        gpu1(hwgraph::Vertex::new_gpu("gpu1")),
+        gpu2(hwgraph::Vertex::new_gpu("gpu2")),
+        up(hwgraph::Edge::new_pci(16)) {
+    using hwgraph::Edge;
+    g.join(cpu, sw, up);
+    g.join(sw, gpu0, Edge::new_pci(16));
+    g.join(sw, gpu1, Edge::new_pci(10));
+    g.join(cpu, gpu2, Edge::new_pci(8));
+  }
+};
@@ -0,0 +1,57 @@
+#include "catch2/catch.hpp"
+
+#include <sched.h>
+
+#include "hwgraph/affinity.hpp"
+
+using namespace hwgraph;
+
+TEST_CASE("affinity", "") {
+
+  Graph g;
+  auto pkg = std::make_shared<Vertex>(Vertex::Type::Intel);
+  auto host = Vertex::new_bridge("host", {0, 0, 0, 0}, 0, 1, 4);
+  auto br = Vertex::new_bridge("switch", {0, 1, 0, 0}, 0, 2, 4);
+  auto gpu = Vertex::new_gpu("gpu");
+  auto lone = Vertex::new_gpu("lone");
+  g.join(pkg, host, Edge::new_pci(16));
+  g.join(host, br, Edge::new_pci(16));
+  g.join(br, gpu, Edge::new_pci(16));
+  g.insert_vertex(lone);
+  pkg->data_.intel.locality.add_cpu(0);
+  pkg->data_.intel.locality.add_cpu(1);
+  pkg->data_.intel.locality.add_node(0);
+  host->data_.bridge_.locality.add_cpu(1);
+  host->data_.bridge_.locality.add_node(0);
+
+  SECTION("closest") {
+    // the host bridge is nearer the GPU than the package
+    Locality l = closest_locality(g, gpu);
+    REQUIRE(l.has_cpu(1));
+    REQUIRE(!l.has_cpu(0));
+    REQUIRE(0 == closest_numa_node(g, gpu));
+    REQUIRE(closest_locality(g, pkg).has_cpu(0));
+    REQUIRE(closest_locality(g, lone).empty());
+    REQUIRE(-1 == closest_numa_node(g, lone));
+  }
+
+  SECTION("bind") {
+    // bind to the CPUs we already have, so this works anywhere
+    cpu_set_t before;
+    REQUIRE(0 == sched_getaffinity(0, sizeof(before), &before));
+    Locality l;
+    std::memset(&l, 0, sizeof(l));
+    for (unsigned i = 0; i < Locality::MAX_CPUS && i < CPU_SETSIZE; ++i) {
+      if (CPU_ISSET(i, &before)) {
+        l.add_cpu(i);
+      }
+    }
+    REQUIRE(bind_thread(l));
+    cpu_set_t after;
+    REQUIRE(0 == sched_getaffinity(0, sizeof(after), &after));
+    REQUIRE(CPU_EQUAL(&before, &after));
+
+    // nothing to bind to
+    REQUIRE(bind_near(g, lone));
+  }
+}
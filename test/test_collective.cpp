@@ -0,0 +1,131 @@
+#include "catch2/catch.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+
+#include "hwgraph/collective.hpp"
+
+using namespace hwgraph;
+
+TEST_CASE("collective", "") {
+
+  Graph g;
+
+  SECTION("nvlink ring") {
+    // an NVLink ring 0-1-2-3 with single-link diagonals, all under one PCIe
+    // switch
+    auto sw = std::make_shared<Vertex>();
+    std::vector<Vertex_t> gpus;
+    for (int i = 0; i < 4; ++i) {
+      gpus.push_back(Vertex::new_gpu(("gpu" + std::to_string(i)).c_str()));
+      g.join(sw, gpus.back(), Edge::new_pci(16));
+    }
+    for (int i = 0; i < 4; ++i) {
+      g.join(gpus[i], gpus[(i + 1) % 4], Edge::new_nvlink(2, 2));
+    }
+    g.join(gpus[0], gpus[2], Edge::new_nvlink(2, 1));
+    g.join(gpus[1], gpus[3], Edge::new_nvlink(2, 1));
+
+    Ring r = best_ring(g, {gpus[0], gpus[2], gpus[1], gpus[3]});
+    REQUIRE(4 == r.order.size());
+    REQUIRE(50e9 == r.bandwidth);
+
+    REQUIRE(std::isinf(best_ring(g, {gpus[0]}).bandwidth));
+    REQUIRE(best_ring(g, {}).order.empty());
+
+    DoubleTree t = double_binary_tree(g, r.order);
+    REQUIRE(t.ranks == r.order);
+    REQUIRE(25e9 <= t.bandwidth);
+  }
+
+  SECTION("exact ring") {
+    // compare against every ring on small random matrices
+    uint64_t seed = 1;
+    auto rand = [&]() {
+      seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+      return double(seed >> 59); // 0..31
+    };
+    for (int64_t n = 2; n <= 7; ++n) {
+      Mat2D<double> bw(n, n, 0);
+      for (int64_t i = 0; i < n; ++i) {
+        for (int64_t j = i + 1; j < n; ++j) {
+          bw(i, j) = bw(j, i) = rand();
+        }
+      }
+      std::vector<int64_t> perm(n);
+      for (int64_t i = 0; i < n; ++i) {
+        perm[i] = i;
+      }
+      double best = -1;
+      do {
+        best = std::max(best, ring_bandwidth(bw, perm));
+      } while (std::next_permutation(perm.begin() + 1, perm.end()));
+
+      std::vector<int64_t> order = best_ring_order(bw);
+      REQUIRE(n == int64_t(order.size()));
+      std::vector<int64_t> sorted = order;
+      std::sort(sorted.begin(), sorted.end());
+      REQUIRE(sorted == perm);
+      REQUIRE(best == ring_bandwidth(bw, order));
+    }
+  }
+
+  SECTION("large ring") {
+    // a 16-GPU NVLink ring, given out of order
+    const int n = 16;
+    std::vector<Vertex_t> gpus;
+    for (int i = 0; i < n; ++i) {
+      gpus.push_back(Vertex::new_gpu(("gpu" + std::to_string(i)).c_str()));
+    }
+    for (int i = 0; i < n; ++i) {
+      g.join(gpus[i], gpus[(i + 1) % n], Edge::new_nvlink(3, 2));
+      g.join(gpus[i], gpus[(i + n / 2) % n], Edge::new_nvlink(3, 1));
+    }
+    std::vector<Vertex_t> shuffled;
+    for (int i = 0; i < n; ++i) {
+      shuffled.push_back(gpus[(i * 5) % n]);
+    }
+    REQUIRE(50e9 == best_ring(g, shuffled).bandwidth);
+  }
+
+  SECTION("btree") {
+    for (int64_t n = 1; n <= 33; ++n) {
+      std::vector<Vertex_t> ranks;
+      for (int64_t r = 0; r < n; ++r) {
+        ranks.push_back(std::make_shared<Vertex>());
+        g.insert_vertex(ranks.back());
+      }
+      DoubleTree t = double_binary_tree(g, ranks);
+
+      std::vector<int> interior(n, 0);
+      for (int tree = 0; tree < 2; ++tree) {
+        std::vector<int> children(n, 0);
+        int roots = 0;
+        for (int64_t r = 0; r < n; ++r) {
+          // every rank reaches the root
+          int64_t steps = 0;
+          for (int64_t p = r; t.parent[tree][p] >= 0; p = t.parent[tree][p]) {
+            REQUIRE(++steps < n);
+          }
+          if (t.parent[tree][r] < 0) {
+            ++roots;
+          } else {
+            ++children[t.parent[tree][r]];
+          }
+        }
+        REQUIRE(1 == roots);
+        for (int64_t r = 0; r < n; ++r) {
+          REQUIRE(children[r] <= 2);
+          interior[r] += children[r] > 0;
+        }
+      }
+
+      // with an even number of ranks, no rank forwards in both trees
+      if (n % 2 == 0) {
+        REQUIRE(interior.end() ==
+                std::find(interior.begin(), interior.end(), 2));
+      }
+    }
+  }
+}
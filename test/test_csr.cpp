@@ -0,0 +1,72 @@
+#include "catch2/catch.hpp"
+
+#include "hwgraph/csr.hpp"
+
+using namespace hwgraph;
+
+TEST_CASE("csr", "") {
+
+  Graph g;
+
+  SECTION("empty") {
+    CsrGraph c = freeze(g);
+    REQUIRE(0 == c.num_vertices());
+    REQUIRE(0 == c.num_edges());
+    REQUIRE(c.paths(CsrGraph::NONE, CsrGraph::NONE).empty());
+  }
+
+  SECTION("diamond") {
+    auto a = std::make_shared<Vertex>();
+    auto b = std::make_shared<Vertex>();
+    auto c = std::make_shared<Vertex>();
+    auto d = std::make_shared<Vertex>(Vertex::Type::Gpu);
+    auto eab = Edge::new_pci(16);
+    auto ebd = Edge::new_pci(4);
+    auto eac = Edge::new_pci(8);
+    auto ecd = Edge::new_pci(8);
+    g.join(a, b, eab);
+    g.join(b, d, ebd);
+    g.join(a, c, eac);
+    g.join(c, d, ecd);
+
+    CsrGraph f = freeze(g);
+    REQUIRE(g.version() == f.version());
+    REQUIRE(4 == f.num_vertices());
+    REQUIRE(4 == f.num_edges());
+    REQUIRE(a == f.vertex(f.id(a)));
+    REQUIRE(ebd == f.edge(f.id(ebd)));
+    REQUIRE(2 == f.adj_end(f.id(a)) - f.adj_begin(f.id(a)));
+    REQUIRE(4e9 == f.bandwidth(f.id(ebd)));
+
+    // same answers as the pointer-based graph
+    REQUIRE(g.paths(a, d).size() == f.paths(f.id(a), f.id(d)).size());
+    REQUIRE(g.widest_path(a, d) == f.to_path(f.widest_path(f.id(a), f.id(d))));
+    REQUIRE(8e9 == f.path_bandwidth(f.widest_path(f.id(a), f.id(d))));
+
+    auto csr_bw = [&](const EdgePath &path) {
+      return float(f.path_bandwidth(path));
+    };
+    EdgePath widest = f.max_path(f.id(a), f.id(d), csr_bw);
+    REQUIRE(8e9 == f.path_bandwidth(widest));
+    REQUIRE(f.to_path(widest) == g.max_path(a, d, path_bandwidth));
+    REQUIRE(4e9 == f.path_bandwidth(f.min_path(f.id(a), f.id(d), csr_bw)));
+    REQUIRE(f.min_path(f.id(a), CsrGraph::NONE, csr_bw).empty());
+    for (const EdgePath &path : f.paths(f.id(a), f.id(d))) {
+      REQUIRE(2 == path.size());
+      const uint32_t mid = f.other_vertex(path[0], f.id(a));
+      REQUIRE(f.id(d) == f.other_vertex(path[1], mid));
+    }
+
+    auto is_gpu = [&](uint32_t v) {
+      return f.vertex_type(v) == Vertex::Type::Gpu;
+    };
+    auto p = f.shortest_path(f.id(a), is_gpu);
+    REQUIRE(2 == p.first.size());
+    REQUIRE(f.id(d) == p.second);
+
+    PairMatrix m = f.all_pairs();
+    REQUIRE(8e9 == m.bandwidth_between(a, d));
+    REQUIRE(2 == m.hops_between(a, d));
+    REQUIRE(m.bandwidth_between(b, c) == g.all_pairs().bandwidth_between(b, c));
+  }
+}
@@ -0,0 +1,88 @@
+#include "catch2/catch.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include "hwgraph/fair_share.hpp"
+
+#include "count_allocs.hpp"
+#include "switch_tree.hpp"
+
+using namespace hwgraph;
+
+TEST_CASE("fair_share", "") {
+
+  SwitchTree tree;
+  Graph &g = tree.g;
+  const Vertex_t &cpu = tree.cpu;
+  const Vertex_t &gpu0 = tree.gpu0, &gpu1 = tree.gpu1, &gpu2 = tree.gpu2;
+  const Edge_t &up = tree.up;
+
+  SECTION("shared uplink") {
+    std::vector<double> r = fair_share(g, {{cpu, gpu0}, {cpu, gpu0}});
+    REQUIRE(8e9 == r[0]);
+    REQUIRE(8e9 == r[1]);
+  }
+
+  SECTION("directions are independent") {
+    std::vector<double> r = fair_share(g, {{cpu, gpu0}, {gpu0, cpu}});
+    REQUIRE(16e9 == r[0]);
+    REQUIRE(16e9 == r[1]);
+  }
+
+  SECTION("progressive filling") {
+    // gpu1's link is split first, then cpu->gpu0 takes the rest of the uplink
+    std::vector<double> r =
+        fair_share(g, {{cpu, gpu0}, {cpu, gpu1}, {gpu0, gpu1}, {cpu, gpu2}});
+    REQUIRE(11e9 == r[0]);
+    REQUIRE(5e9 == r[1]);
+    REQUIRE(5e9 == r[2]);
+    REQUIRE(8e9 == r[3]);
+  }
+
+  SECTION("trivial flows") {
+    auto island = std::make_shared<Vertex>();
+    g.insert_vertex(island);
+    std::vector<double> r = fair_share(g, {{cpu, cpu}, {cpu, island}});
+    REQUIRE(std::isinf(r[0]));
+    REQUIRE(0 == r[1]);
+  }
+
+  SECTION("explicit paths") {
+    CsrGraph c = freeze(g);
+    FairShare solver(c);
+    const uint32_t vcpu = c.id(cpu), vgpu0 = c.id(gpu0);
+
+    std::vector<FairFlow> flows(2);
+    flows[0].src = vgpu0;
+    flows[0].dst = vcpu;
+    flows[1].src = vcpu;
+    flows[1].dst = vgpu0;
+    flows[1].path = c.widest_path(vgpu0, vcpu);
+    std::reverse(flows[1].path.begin(), flows[1].path.end());
+    REQUIRE(c.id(up) == flows[1].path[0]);
+
+    std::vector<double> r = solver.solve(flows);
+    REQUIRE(16e9 == r[0]);
+    REQUIRE(16e9 == r[1]);
+  }
+
+  SECTION("batch") {
+    CsrGraph c = freeze(g);
+    FairShare solver(c);
+    std::vector<FairFlow> flows(1000);
+    for (size_t i = 0; i < flows.size(); ++i) {
+      flows[i].src = c.id(i % 2 ? gpu0 : gpu2);
+      flows[i].dst = c.id(gpu1);
+    }
+    solver.solve(flows, Routing::Hops);
+
+    const size_t before = num_allocations();
+    const std::vector<double> &r = solver.solve(flows, Routing::Hops);
+    REQUIRE(before == num_allocations());
+
+    // the 500 flows from each GPU fill gpu1's link, and all share it equally
+    REQUIRE(Approx(10e9 / 1000) == r[0]);
+    REQUIRE(Approx(10e9 / 1000) == r[1]);
+  }
+}
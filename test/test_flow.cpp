@@ -0,0 +1,76 @@
+#include "catch2/catch.hpp"
+
+#include <algorithm>
+
+#include "hwgraph/flow.hpp"
+
+using namespace hwgraph;
+
+TEST_CASE("flow", "") {
+
+  Graph g;
+
+  // two GPUs under one switch, joined by NVLink, and a third GPU directly
+  // under the CPU
+  auto cpu = std::make_shared<Vertex>();
+  auto sw = std::make_shared<Vertex>();
+  auto gpu0 = Vertex::new_gpu("gpu0");
+  auto gpu1 = Vertex::new_gpu("gpu1");
+  auto gpu2 = Vertex::new_gpu("gpu2");
+  auto up = Edge::new_pci(16);
+  auto e0 = Edge::new_pci(16);
+  auto e1 = Edge::new_pci(16);
+  auto e2 = Edge::new_pci(8);
+  auto nvl = Edge::new_nvlink(2, 2); // 50 GB/s
+  g.join(cpu, sw, up);
+  g.join(sw, gpu0, e0);
+  g.join(sw, gpu1, e1);
+  g.join(cpu, gpu2, e2);
+  g.join(gpu0, gpu1, nvl);
+
+  SECTION("switch uplink") {
+    MaxFlow f = max_flow(g, {gpu0, gpu1}, {cpu});
+    REQUIRE(16000000000 == f.value);
+    REQUIRE(1 == f.cut.size());
+    REQUIRE(up == f.cut[0]);
+  }
+
+  SECTION("parallel paths") {
+    MaxFlow f = max_flow(g, {gpu0}, {gpu1});
+    REQUIRE(66000000000 == f.value);
+    REQUIRE(2 == f.cut.size());
+    REQUIRE(f.cut.end() != std::find(f.cut.begin(), f.cut.end(), nvl));
+  }
+
+  SECTION("full duplex") {
+    // every link out of gpu0 and gpu2 is saturated
+    MaxFlow f = max_flow(g, {gpu0, gpu2}, {gpu1, cpu});
+    REQUIRE(66000000000 + 8000000000 == f.value);
+  }
+
+  SECTION("reuse") {
+    CsrGraph c = freeze(g);
+    FlowNetwork net(c);
+    REQUIRE(8000000000 == net.max_flow({c.id(gpu2)}, {c.id(gpu0)}).value);
+    MaxFlow f = net.max_flow({c.id(gpu0), c.id(gpu1)}, {c.id(cpu)});
+    REQUIRE(16000000000 == f.value);
+    REQUIRE(std::vector<uint32_t>{c.id(up)} == f.cutIds);
+  }
+
+  SECTION("disconnected") {
+    auto island = std::make_shared<Vertex>();
+    g.insert_vertex(island);
+    MaxFlow f = max_flow(g, {gpu0}, {island});
+    REQUIRE(0 == f.value);
+    REQUIRE(f.cut.empty());
+  }
+
+  SECTION("not in graph") {
+    auto stranger = Vertex::new_gpu("stranger");
+    MaxFlow f = max_flow(g, {stranger}, {gpu1});
+    REQUIRE(0 == f.value);
+    REQUIRE(f.cut.empty());
+    REQUIRE(0 == max_flow(g, {gpu0}, {stranger}).value);
+    REQUIRE(16000000000 == max_flow(g, {gpu0, stranger}, {cpu}).value);
+  }
+}
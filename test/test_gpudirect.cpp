@@ -0,0 +1,75 @@
+#include "catch2/catch.hpp"
+
+#include "hwgraph/gpudirect.hpp"
+
+using namespace hwgraph;
+
+TEST_CASE("gpudirect", "") {
+
+  // a GPU and a NIC below one switch, a closer-looking NIC on the CPU, and a
+  // drive on the other socket
+  Graph g;
+  auto cpu0 = std::make_shared<Vertex>(Vertex::Type::Intel);
+  auto cpu1 = std::make_shared<Vertex>(Vertex::Type::Intel);
+  auto sw = Vertex::new_bridge("switch", {0, 1, 0, 0}, 0, 2, 4);
+  auto gpu = Vertex::new_gpu("gpu");
+  auto nic0 = std::make_shared<Vertex>(Vertex::Type::Nic);
+  auto nic1 = std::make_shared<Vertex>(Vertex::Type::Nic);
+  auto nvme = std::make_shared<Vertex>(Vertex::Type::Storage);
+  g.join(cpu0, cpu1, Edge::new_xbus(32000000000));
+  g.join(cpu0, sw, Edge::new_pci(16));
+  g.join(sw, gpu, Edge::new_pci(16));
+  g.join(sw, nic0, Edge::new_pci(8));
+  g.join(cpu0, nic1, Edge::new_pci(16));
+  g.join(cpu1, nvme, Edge::new_pci(4));
+
+  SECTION("nic") {
+    // nic1 is as few hops away, but through the CPU
+    auto p = closest_nic(g, gpu);
+    REQUIRE(nic0 == p.second);
+    REQUIRE(2 == p.first.size());
+    REQUIRE(!crosses_cpu(p.first));
+
+    // among NICs through the CPU, the wider one
+    auto nic2 = std::make_shared<Vertex>(Vertex::Type::Nic);
+    g.join(cpu0, nic2, Edge::new_pci(4));
+    REQUIRE(nic1 == closest_nic(g, cpu0).second);
+  }
+
+  SECTION("storage") {
+    // the drive on the other socket is only reachable over the X-Bus
+    REQUIRE(!closest_storage(g, gpu).second);
+    REQUIRE(nvme == closest_storage(g, cpu1).second);
+
+    auto nvme0 = std::make_shared<Vertex>(Vertex::Type::Storage);
+    g.join(cpu0, nvme0, Edge::new_pci(4));
+    auto p = closest_storage(g, gpu);
+    REQUIRE(nvme0 == p.second);
+    REQUIRE(3 == p.first.size());
+    REQUIRE(crosses_cpu(p.first));
+  }
+
+  SECTION("pci only") {
+    // an NVLink to a GPU beside nic1 does not make nic1 closer to gpu
+    auto gpu1 = Vertex::new_gpu("gpu1");
+    g.join(cpu0, gpu1, Edge::new_pci(16));
+    g.join(gpu, gpu1, Edge::new_nvlink(2, 4));
+    auto p = closest_nic(g, gpu1);
+    REQUIRE(nic1 == p.second);
+    REQUIRE(2 == p.first.size());
+    p = closest_nic(g, gpu);
+    REQUIRE(nic0 == p.second);
+    for (const Edge_t &e : p.first) {
+      REQUIRE(Edge::Type::Pci == e->type_);
+    }
+  }
+
+  SECTION("none") {
+    REQUIRE(!closest_of_type(g, gpu, Vertex::Type::Coprocessor).second);
+    auto lone = Vertex::new_gpu("lone");
+    g.insert_vertex(lone);
+    auto p = closest_nic(g, lone);
+    REQUIRE(!p.second);
+    REQUIRE(p.first.empty());
+  }
+}
@@ -2,6 +2,8 @@
 
 #include "hwgraph/graph.hpp"
 
+#include "count_allocs.hpp"
+
 using namespace hwgraph;
 
 TEST_CASE("graph", "") {
@@ -134,4 +136,400 @@ TEST_CASE("graph", "") {
 
   }
 
+  SECTION("widest_path") {
+    auto a = std::make_shared<Vertex>();
+    auto b = std::make_shared<Vertex>();
+    auto c = std::make_shared<Vertex>();
+    auto d = std::make_shared<Vertex>();
+    auto eab = Edge::new_pci(16);
+    auto ebd = Edge::new_pci(4);
+    auto eac = Edge::new_pci(8);
+    auto ecd = Edge::new_pci(8);
+
+    g.join(a, b, eab);
+    g.join(b, d, ebd);
+    g.join(a, c, eac);
+    g.join(c, d, ecd);
+
+    Path path = g.widest_path(a, d);
+    REQUIRE(2 == path.size());
+    REQUIRE(eac == path[0]);
+    REQUIRE(ecd == path[1]);
+    REQUIRE(path_bandwidth(path) ==
+            path_bandwidth(g.max_path(a, d, path_bandwidth)));
+
+    // backwards path
+    path = g.widest_path(d, a);
+    REQUIRE(2 == path.size());
+    REQUIRE(ecd == path[0]);
+    REQUIRE(eac == path[1]);
+
+    // no path
+    auto e = std::make_shared<Vertex>();
+    g.insert_vertex(e);
+    REQUIRE(g.widest_path(a, e).empty());
+  }
+
+  SECTION("all_pairs") {
+    auto a = std::make_shared<Vertex>();
+    auto b = std::make_shared<Vertex>();
+    auto c = std::make_shared<Vertex>();
+    g.join(a, b, Edge::new_pci(16));
+    g.join(b, c, Edge::new_pci(4));
+
+    const PairMatrix &m = g.all_pairs();
+    REQUIRE(g.version() == m.version);
+    REQUIRE(16e9 == m.bandwidth_between(a, b));
+    REQUIRE(4e9 == m.bandwidth_between(c, a));
+    REQUIRE(2 == m.hops_between(a, c));
+    REQUIRE(0 == m.hops_between(b, b));
+
+    // cached until the graph changes
+    const uint64_t version = m.version;
+    REQUIRE(&m == &g.all_pairs());
+    REQUIRE(version == g.all_pairs().version);
+
+    auto d = std::make_shared<Vertex>();
+    g.join(a, d, Edge::new_pci(8));
+    REQUIRE(version != g.all_pairs().version);
+    REQUIRE(4e9 == g.all_pairs().bandwidth_between(c, d));
+
+    auto e = std::make_shared<Vertex>();
+    g.insert_vertex(e);
+    REQUIRE(-1 == g.all_pairs().bandwidth_between(a, e));
+    REQUIRE(-1 == g.all_pairs().hops_between(a, e));
+  }
+
+  SECTION("pci_index") {
+    // host bridge owns buses 0-10, a switch under it owns 2-5
+    auto host = Vertex::new_bridge("host", {0, 0, 0, 0}, 0, 0, 10);
+    auto sw = Vertex::new_bridge("switch", {0, 1, 0, 0}, 0, 2, 5);
+    auto dev = Vertex::new_pci_device("dev", {0, 3, 0, 0}, 16);
+    g.insert_vertex(host);
+    g.insert_vertex(sw);
+    g.insert_vertex(dev);
+
+    REQUIRE(dev == g.get_pci({0, 3, 0, 0}));
+    REQUIRE(sw == g.get_pci({0, 1, 0, 0}));
+    REQUIRE(nullptr == g.get_pci({0, 3, 1, 0}));
+
+    REQUIRE(host == g.get_bridge_for_address({0, 1, 0, 0}));
+    REQUIRE(sw == g.get_bridge_for_address({0, 3, 0, 0}));
+    REQUIRE(host == g.get_bridge_for_address({0, 7, 0, 0}));
+    REQUIRE(nullptr == g.get_bridge_for_address({1, 3, 0, 0}));
+    REQUIRE(nullptr == g.get_bridge_for_address({0, 11, 0, 0}));
+
+    // replaced vertices are re-indexed
+    auto gpu = Vertex::new_gpu("gpu", dev->data_.pciDev);
+    g.replace(dev, gpu);
+    REQUIRE(gpu == g.get_pci({0, 3, 0, 0}));
+
+    auto sw2 = Vertex::new_bridge("switch2", {0, 1, 0, 0}, 0, 2, 5);
+    g.replace(sw, sw2);
+    REQUIRE(sw2 == g.get_bridge_for_address({0, 3, 0, 0}));
+  }
+
+  SECTION("shortest_path") {
+    // package - bridge - bridge - gpu, with a shortcut bridge - gpu2
+    auto pkg = std::make_shared<Vertex>(Vertex::Type::Intel);
+    auto br0 = Vertex::new_bridge("br0", {0, 0, 1, 0}, 0, 1, 3);
+    auto br1 = Vertex::new_bridge("br1", {0, 1, 0, 0}, 0, 2, 3);
+    auto gpu = Vertex::new_gpu("gpu");
+    auto gpu2 = Vertex::new_gpu("gpu2");
+    g.join(pkg, br0, Edge::new_pci(16));
+    g.join(br0, br1, Edge::new_pci(16));
+    g.join(br1, gpu, Edge::new_pci(16));
+    g.join(br0, gpu2, Edge::new_pci(16));
+
+    auto p = g.shortest_path(gpu, Vertex::is_package);
+    REQUIRE(pkg == p.second);
+    REQUIRE(3 == p.first.size());
+    REQUIRE(gpu == p.first.front()->other_vertex(br1));
+    REQUIRE(pkg == p.first.back()->other_vertex(br0));
+
+    // src itself is not a match
+    p = g.shortest_path(pkg, Vertex::is_package);
+    REQUIRE(nullptr == p.second);
+    REQUIRE(p.first.empty());
+
+    auto is_gpu = [](const Vertex_t &v) {
+      return v->type_ == Vertex::Type::Gpu;
+    };
+    p = g.shortest_path(pkg, is_gpu);
+    REQUIRE(gpu2 == p.second);
+    REQUIRE(2 == p.first.size());
+
+    // once warm, a search into an existing path does not allocate
+    Path path;
+    path.reserve(8);
+    REQUIRE(pkg == g.shortest_path(gpu, Vertex::is_package, path));
+    const size_t before = num_allocations();
+    Vertex_t found = g.shortest_path(gpu, Vertex::is_package, path);
+    REQUIRE(num_allocations() == before);
+    REQUIRE(pkg == found);
+    REQUIRE(3 == path.size());
+
+    // the scratch buffers follow graph changes
+    auto pkg2 = std::make_shared<Vertex>(Vertex::Type::Intel);
+    g.join(gpu, pkg2, Edge::new_pci(16));
+    REQUIRE(pkg2 == g.shortest_path(gpu, Vertex::is_package, path));
+    REQUIRE(1 == path.size());
+  }
+
+  SECTION("enumerate_paths") {
+    auto a = std::make_shared<Vertex>();
+    auto b = std::make_shared<Vertex>();
+    auto c = std::make_shared<Vertex>();
+    auto d = std::make_shared<Vertex>();
+    g.join(a, b, Edge::new_pci(16));
+    g.join(b, d, Edge::new_pci(4));
+    g.join(a, c, Edge::new_pci(8));
+    g.join(c, d, Edge::new_pci(8));
+
+    // same paths, in the same order, as paths()
+    std::vector<Path> all = g.paths(a, d);
+    REQUIRE(2 == all.size());
+    PathEnumerator paths = g.enumerate_paths(a, d);
+    Path path;
+    for (const Path &p : all) {
+      REQUIRE(paths.next(path));
+      REQUIRE(p == path);
+    }
+    REQUIRE(!paths.next(path));
+    REQUIRE(path.empty());
+
+    // prune prefixes that can't beat a bottleneck of 4
+    auto wider = [](const Path &prefix) {
+      return path_bandwidth(prefix) > 4e9;
+    };
+    paths = g.enumerate_paths(a, d, wider);
+    REQUIRE(paths.next(path));
+    REQUIRE(8e9 == path_bandwidth(path));
+    REQUIRE(!paths.next(path));
+
+    REQUIRE(8e9 == path_bandwidth(g.max_path(a, d, path_bandwidth)));
+    REQUIRE(4e9 == path_bandwidth(g.min_path(a, d, path_bandwidth)));
+
+    // restarting a warm enumerator does not allocate
+    paths.reset(a, d);
+    while (paths.next(path)) {
+    }
+    const size_t before = num_allocations();
+    paths.reset(d, a);
+    REQUIRE(paths.next(path));
+    const size_t after = num_allocations();
+    REQUIRE(after == before);
+  }
+
+  SECTION("cost policies") {
+    auto a = std::make_shared<Vertex>();
+    auto b = std::make_shared<Vertex>();
+    auto c = std::make_shared<Vertex>();
+    auto d = std::make_shared<Vertex>();
+    auto e = std::make_shared<Vertex>();
+    auto f = std::make_shared<Vertex>();
+    g.join(a, b, Edge::new_pci(16));
+    g.join(b, d, Edge::new_pci(4));
+    g.join(a, c, Edge::new_pci(8));
+    g.join(c, d, Edge::new_pci(8));
+    g.join(a, e, Edge::new_pci(32));
+    g.join(e, f, Edge::new_pci(32));
+    g.join(f, d, Edge::new_pci(32));
+
+    Path p = g.max_path<cost::Bottleneck>(a, d);
+    REQUIRE(3 == p.size());
+    REQUIRE(32e9 == path_cost<cost::Bottleneck>(p));
+    REQUIRE(p == g.max_path(a, d, path_bandwidth));
+
+    p = g.min_path<cost::Bottleneck>(a, d);
+    REQUIRE(4e9 == path_cost<cost::Bottleneck>(p));
+
+    auto hops = [](const Path &path) { return float(path.size()); };
+    p = g.min_path<cost::Hops>(a, d);
+    REQUIRE(2 == path_cost<cost::Hops>(p));
+    REQUIRE(p == g.min_path(a, d, hops));
+    REQUIRE(3 == g.max_path<cost::Hops>(a, d).size());
+
+    REQUIRE(g.min_path<cost::Hops>(nullptr, d).empty());
+  }
+
+  SECTION("cost policies match cost functions") {
+    // a 3x3 grid, where routes share edges and the enumeration misses some
+    std::vector<Vertex_t> v;
+    for (int i = 0; i < 9; ++i) {
+      v.push_back(std::make_shared<Vertex>());
+    }
+    for (int r = 0; r < 3; ++r) {
+      for (int c = 0; c < 3; ++c) {
+        if (c < 2) {
+          g.join(v[3 * r + c], v[3 * r + c + 1], Edge::new_pci(4 * (r + 1)));
+        }
+        if (r < 2) {
+          g.join(v[3 * r + c], v[3 * r + c + 3], Edge::new_pci(4 * (c + 1)));
+        }
+      }
+    }
+
+    auto hops = [](const Path &path) { return float(path.size()); };
+    for (const Vertex_t &dst : v) {
+      REQUIRE(g.min_path<cost::Hops>(v[0], dst) ==
+              g.min_path(v[0], dst, hops));
+      REQUIRE(g.max_path<cost::Bottleneck>(v[0], dst) ==
+              g.max_path(v[0], dst, path_bandwidth));
+    }
+  }
+
+  SECTION("bandwidth model") {
+    // hwloc reports gen3 x16 as 15.75 GB/s
+    auto pci = Edge::new_pci(15.75);
+    REQUIRE(15750000000 == pci->bandwidth());
+    pci->data_.pci.lanes = 16;
+    REQUIRE(3 == pci->pci_generation());
+
+    auto gen4 = Edge::new_pcie(4, 8);
+    REQUIRE(4 == gen4->pci_generation());
+    REQUIRE(8 == gen4->data_.pci.lanes);
+    REQUIRE(std::abs(gen4->bandwidth() - pcie_bandwidth(4, 8)) < 1000);
+
+    // a lane count without a speed is taken to be gen3
+    auto lanesOnly = std::make_shared<Edge>(Edge::Type::Pci);
+    lanesOnly->data_.pci.lanes = 4;
+    REQUIRE(pcie_bandwidth(3, 4) == lanesOnly->bandwidth());
+
+    auto nvlink = Edge::new_nvlink(2, 6);
+    REQUIRE(nvlink->has_bandwidth());
+    REQUIRE(150000000000 == nvlink->bandwidth());
+    REQUIRE(!Edge::new_nvlink(0, 1)->has_bandwidth());
+    REQUIRE(!Edge::new_nvlink(NVLINK_MAX_VERSION + 1, 1)->has_bandwidth());
+
+    // versions are nvmlNvlinkVersion_t values, not NVLink generations
+    REQUIRE(25000000000 == Edge::new_nvlink(4, 1)->bandwidth()); // 3.0
+    REQUIRE(12 * 25000000000 == Edge::new_nvlink(5, 12)->bandwidth()); // 3.1
+    REQUIRE(18 * 25000000000 == Edge::new_nvlink(6, 18)->bandwidth()); // 4.0
+    REQUIRE(18 * 50000000000 == Edge::new_nvlink(7, 18)->bandwidth()); // 5.0
+    REQUIRE(7 == NVLINK_MAX_VERSION);
+
+    auto qpi = std::make_shared<Edge>(Edge::Type::Qpi);
+    qpi->data_.qpi_.links_ = 2;
+    qpi->data_.qpi_.speed_ = 8 * Edge::QPI_GT;
+    REQUIRE(32000000000 == qpi->bandwidth());
+
+    // paths across NVLink can be ranked
+    auto gpu0 = Vertex::new_gpu("gpu0");
+    auto gpu1 = Vertex::new_gpu("gpu1");
+    auto sw = std::make_shared<Vertex>();
+    g.join(gpu0, sw, Edge::new_pcie(3, 16));
+    g.join(sw, gpu1, Edge::new_pcie(3, 16));
+    g.join(gpu0, gpu1, Edge::new_nvlink(2, 2));
+    Path p = g.widest_path(gpu0, gpu1);
+    REQUIRE(1 == p.size());
+    REQUIRE(50e9 == path_bandwidth(p));
+  }
+
+  SECTION("latency") {
+    // cpu - sw - gpu0 and sw - gpu1 over PCIe, plus NVLink gpu0 - gpu1
+    auto cpu = std::make_shared<Vertex>(Vertex::Type::Intel);
+    auto sw = Vertex::new_bridge("sw", {0, 0, 1, 0}, 0, 1, 3);
+    auto gpu0 = Vertex::new_gpu("gpu0");
+    auto gpu1 = Vertex::new_gpu("gpu1");
+    auto root = Edge::new_pcie(3, 16);
+    g.join(cpu, sw, root);
+    g.join(sw, gpu0, Edge::new_pcie(3, 16));
+    g.join(sw, gpu1, Edge::new_pcie(3, 16));
+    auto nvlink = Edge::new_nvlink(2, 2);
+    g.join(gpu0, gpu1, nvlink);
+
+    REQUIRE(PCIE_ROOT_COMPLEX_LATENCY == root->latency());
+    REQUIRE(NVLINK_LATENCY == nvlink->latency());
+    REQUIRE(!std::make_shared<Edge>()->has_latency());
+
+    // a direct NVLink has less latency than two PCIe switch hops
+    REQUIRE(Path{nvlink} == g.lowest_latency_path(gpu0, gpu1));
+    REQUIRE(Path{nvlink} == g.fastest_path(gpu0, gpu1, 8));
+
+    // unless it was measured slower
+    nvlink->latency_ = 1e-6;
+    REQUIRE(1e-6 == nvlink->latency());
+    Path p = g.lowest_latency_path(gpu0, gpu1);
+    REQUIRE(2 == p.size());
+    REQUIRE(2 * PCIE_SWITCH_HOP_LATENCY == path_latency(p));
+    REQUIRE(p == g.min_path<cost::Latency>(gpu0, gpu1));
+
+    // small messages take the low-latency path, large ones the wide path
+    REQUIRE(p == g.fastest_path(gpu0, gpu1, 8));
+    REQUIRE(Path{nvlink} == g.fastest_path(gpu0, gpu1, 1 << 20));
+    REQUIRE(path_time(p, 8) == g.time(gpu0, gpu1, 8));
+    const double big = 1 << 20;
+    REQUIRE(1e-6 + big / 50e9 == Approx(g.time(gpu0, gpu1, big)));
+    REQUIRE(0 == g.time(gpu0, gpu0, big));
+
+    auto island = std::make_shared<Vertex>();
+    g.insert_vertex(island);
+    REQUIRE(std::isinf(g.time(gpu0, island, big)));
+  }
+
+  SECTION("unmodeled edges") {
+    // a core on-chip from its L3, whose NUMA node has no bandwidth reported
+    auto node = std::make_shared<Vertex>(Vertex::Type::NumaNode);
+    auto l3 = std::make_shared<Vertex>(Vertex::Type::L3);
+    auto core = std::make_shared<Vertex>(Vertex::Type::Core);
+    auto mem = Edge::new_memory(0);
+    auto onchip = Edge::new_onchip();
+    g.join(node, l3, mem);
+    g.join(l3, core, onchip);
+
+    REQUIRE(-1 == path_bandwidth(Path{mem}));
+    REQUIRE(MEMORY_LATENCY == path_latency(Path{mem}));
+    REQUIRE(std::isinf(path_time(Path{mem}, 8)));
+    REQUIRE(-1 == path_bandwidth(Path{mem, onchip}));
+    REQUIRE(std::isinf(path_latency(Path{mem, onchip})));
+    REQUIRE(std::isinf(path_time(Path{onchip}, 8)));
+
+    mem->data_.memory_.bw_ = 100000000000;
+    REQUIRE(100e9 == path_bandwidth(Path{mem}));
+    REQUIRE(MEMORY_LATENCY + 1 / 100e9 == path_time(Path{mem}, 1));
+
+    REQUIRE(std::string::npos != mem->str().find("memory"));
+    REQUIRE("{type: onchip}" == onchip->str());
+  }
+
+  SECTION("pareto_paths") {
+    // gpu0 - gpu1 directly over NVLink, through one PCIe switch, and
+    // through two switches with narrower links
+    auto gpu0 = Vertex::new_gpu("gpu0");
+    auto gpu1 = Vertex::new_gpu("gpu1");
+    auto sw0 = Vertex::new_bridge("sw0", {0, 0, 1, 0}, 0, 1, 3);
+    auto sw1 = Vertex::new_bridge("sw1", {0, 0, 2, 0}, 0, 4, 5);
+    auto sw2 = Vertex::new_bridge("sw2", {0, 0, 3, 0}, 0, 6, 7);
+    auto nvlink = Edge::new_nvlink(2, 2);
+    g.join(gpu0, gpu1, nvlink);
+    g.join(gpu0, sw0, Edge::new_pcie(3, 16));
+    g.join(sw0, gpu1, Edge::new_pcie(3, 16));
+    g.join(gpu0, sw1, Edge::new_pcie(3, 8));
+    g.join(sw1, sw2, Edge::new_pcie(3, 8));
+    g.join(sw2, gpu1, Edge::new_pcie(3, 8));
+
+    // the NVLink is best in every objective
+    std::vector<ParetoPath> front = g.pareto_paths(gpu0, gpu1);
+    REQUIRE(1 == front.size());
+    REQUIRE(Path{nvlink} == front[0].path);
+
+    // a slow NVLink trades latency for bandwidth
+    nvlink->latency_ = 1e-6;
+    front = g.pareto_paths(gpu0, gpu1);
+    REQUIRE(2 == front.size());
+
+    // lowest latency first: two switch hops beat one slow NVLink
+    REQUIRE(2 == front[0].hops);
+    REQUIRE(2 * PCIE_SWITCH_HOP_LATENCY == front[0].latency);
+    REQUIRE(path_bandwidth(front[0].path) == front[0].bandwidth);
+    REQUIRE(front[0].path == g.lowest_latency_path(gpu0, gpu1));
+
+    REQUIRE(1 == front[1].hops);
+    REQUIRE(50e9 == front[1].bandwidth);
+    REQUIRE(front[1].path == g.widest_path(gpu0, gpu1));
+
+    REQUIRE(g.pareto_paths(gpu0, gpu0).empty());
+  }
+
 }
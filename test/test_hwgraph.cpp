@@ -1,5 +1,7 @@
 #include "catch2/catch.hpp"
 
+#include "hwgraph/affinity.hpp"
+#include "hwgraph/gpudirect.hpp"
 #include "hwgraph/hwgraph.hpp"
 
 TEST_CASE("hwgraph", "[hwloc][nvml]") {
@@ -28,3 +30,144 @@ TEST_CASE("hwgraph", "[hwloc][nvml]") {
 
   std::cerr << g.dot_str() << "\n";
 }
+
+#if HWGRAPH_USE_HWLOC == 1
+TEST_CASE("hwgraph xml", "[hwloc]") {
+
+  using namespace hwgraph;
+
+  const std::string path =
+      std::string(HWGRAPH_TEST_TOPOLOGY_DIR) + "/2socket-4gpu.xml";
+  Graph g = make_graph(DiscoveryMethod::Hwloc, hwloc::Topology::from_xml(path));
+
+  auto is_nvidia = [](Vertex_t v) {
+    return v->type_ == Vertex::Type::PciDev &&
+           v->data_.pciDev.vendorId == 0x10de;
+  };
+  auto gpus = g.get_vertices(is_nvidia);
+  REQUIRE(2 == g.vertices<Vertex::Type::Intel>().size());
+  REQUIRE(4 == gpus.size());
+
+  // both packages are Broadwell, so they are joined by QPI
+  auto p0 = g.get_package(0);
+  auto p1 = g.get_package(1);
+  REQUIRE(p0);
+  REQUIRE(p1);
+  Path qpi = g.widest_path(p0, p1);
+  REQUIRE(1 == qpi.size());
+  REQUIRE(Edge::Type::Qpi == qpi[0]->type_);
+
+  // each GPU hangs off its own switch port, four hops below its package
+  auto gpu = g.get_pci({0, 0x82, 0, 0});
+  REQUIRE(gpu);
+  REQUIRE(g.get_pci({0, 0x81, 0x08, 0}) ==
+          g.get_bridge_for_address({0, 0x82, 0, 0}));
+  REQUIRE(4 == g.all_pairs().hops_between(p1, gpu));
+  REQUIRE(5 == g.all_pairs().hops_between(p0, gpu));
+
+  // the GPU is local to the second package's CPUs and NUMA node
+  REQUIRE(p1->data_.intel.locality.has_cpu(2));
+  Locality l = closest_locality(g, gpu);
+  REQUIRE(l.has_cpu(2));
+  REQUIRE(l.has_cpu(3));
+  REQUIRE(!l.has_cpu(0));
+  REQUIRE(1 == closest_numa_node(g, gpu));
+  REQUIRE(0 == closest_numa_node(g, p0));
+
+  // one NUMA node and one L3 of two cores per package
+  REQUIRE(2 == g.vertices<Vertex::Type::NumaNode>().size());
+  REQUIRE(2 == g.vertices<Vertex::Type::L3>().size());
+  REQUIRE(4 == g.vertices<Vertex::Type::Core>().size());
+  Path mem = g.shortest_path(p1, [](const Vertex_t &v) {
+                return v->type_ == Vertex::Type::NumaNode;
+              }).first;
+  REQUIRE(1 == mem.size());
+  REQUIRE(Edge::Type::Memory == mem[0]->type_);
+  REQUIRE(1 == mem[0]->other_vertex(p1)->data_.numaNode.idx);
+
+  // the GPU's cores are the second package's, and share its L3
+  std::vector<Vertex_t> cores = closest_cores(g, gpu);
+  REQUIRE(2 == cores.size());
+  REQUIRE(2 == cores[0]->data_.core.idx);
+  REQUIRE(0 == cores[0]->data_.core.pkgIdx);
+  REQUIRE(1 == cores[1]->data_.core.pkgIdx);
+  REQUIRE(2 == g.all_pairs().hops_between(cores[0], cores[1]));
+  REQUIRE(2 == g.all_pairs().hops_between(p1, cores[0]));
+
+  // the InfiniBand adapter is on the first package, the NVMe drive on the
+  // second
+  Vertex_t nic = g.get_pci({0, 0, 3, 0});
+  REQUIRE(Vertex::Type::Nic == nic->type_);
+  REQUIRE(nic->data_.osDev.has_name("ib0"));
+  REQUIRE(nic->data_.osDev.has_name("mlx5_0"));
+  Vertex_t nvme = g.get_pci({0, 0x80, 3, 0});
+  REQUIRE(Vertex::Type::Storage == nvme->type_);
+  REQUIRE(std::string("nvme0n1") == nvme->data_.osDev.names);
+  REQUIRE(0x144d == nvme->data_.osDev.pciDev.vendorId);
+
+  auto gds = closest_storage(g, gpu);
+  REQUIRE(nvme == gds.second);
+  REQUIRE(!crosses_cpu(gds.first));
+  // the only NIC is across the link between packages
+  REQUIRE(!closest_nic(g, gpu).second);
+  REQUIRE(!crosses_cpu(closest_nic(g, g.get_pci({0, 2, 0, 0})).first));
+}
+
+TEST_CASE("hwgraph synthetic", "[hwloc]") {
+
+  using namespace hwgraph;
+
+  Graph g = make_graph(DiscoveryMethod::Hwloc,
+                       hwloc::Topology::from_synthetic("pack:2 core:2 pu:1"));
+  int64_t numPackages = 0;
+  for (auto v : g.vertices()) {
+    if (Vertex::is_package(v)) {
+      ++numPackages;
+    }
+  }
+  REQUIRE(2 == numPackages);
+
+  // without L3s, cores hang off their package, and the one NUMA node is
+  // shared by both packages
+  auto cores = g.vertices<Vertex::Type::Core>();
+  REQUIRE(4 == cores.size());
+  for (auto c : cores) {
+    REQUIRE(c->data_.core.pkgIdx < 2);
+    REQUIRE(1 == g.shortest_path(c, Vertex::is_package).first.size());
+  }
+  auto nodes = g.vertices<Vertex::Type::NumaNode>();
+  REQUIRE(1 == nodes.size());
+  REQUIRE(2 == (*nodes.begin())->edges_.size());
+
+  REQUIRE_THROWS(hwloc::Topology::from_xml("does-not-exist.xml"));
+}
+#endif
+
+#if HWGRAPH_USE_HWLOC == 1
+TEST_CASE("hwgraph cached", "[hwloc]") {
+
+  using namespace hwgraph;
+
+  const std::string path = "test_hwgraph_cached.bin";
+  std::remove(path.c_str());
+
+  // a snapshot taken without hwloc is not reused when hwloc is asked for
+  Graph empty = make_graph_cached(DiscoveryMethod::None, path);
+  REQUIRE(empty.vertices().empty());
+  Graph g = make_graph_cached(DiscoveryMethod::Hwloc, path);
+  REQUIRE(!g.vertices().empty());
+  REQUIRE(g.vertices().size() ==
+          make_graph_cached(DiscoveryMethod::Hwloc, path).vertices().size());
+  REQUIRE(make_graph_cached(DiscoveryMethod::None, path).vertices().empty());
+
+  // the snapshot can't be written, but discovery still succeeds
+  const std::string unwritable = "does-not-exist/test_hwgraph_cached.bin";
+  REQUIRE(g.vertices().size() ==
+          make_graph_cached(DiscoveryMethod::Hwloc, unwritable)
+              .vertices()
+              .size());
+  REQUIRE_THROWS(Snapshot(unwritable));
+
+  std::remove(path.c_str());
+}
+#endif
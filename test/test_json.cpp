@@ -0,0 +1,109 @@
+#include "catch2/catch.hpp"
+
+#include <sstream>
+
+#include "hwgraph/json.hpp"
+
+using namespace hwgraph;
+
+TEST_CASE("json", "") {
+
+  Graph g;
+  auto pkg = std::make_shared<Vertex>(Vertex::Type::Intel);
+  pkg->name_ = "cpu";
+  std::strcpy(pkg->data_.intel.model, "Xeon");
+  pkg->data_.intel.modelNumber = 0x4f;
+  pkg->data_.intel.locality.add_cpu(2);
+  pkg->data_.intel.locality.add_cpu(67);
+  pkg->data_.intel.locality.add_node(1);
+  auto br = Vertex::new_bridge("bridge", {0, 0, 1, 0}, 0, 1, 3);
+  PciDeviceData pciDev = {};
+  pciDev.addr = {0, 2, 0, 0};
+  pciDev.vendorId = 0x10de;
+  pciDev.linkSpeed = 15.75;
+  auto gpu = Vertex::new_gpu("gpu", pciDev);
+  gpu->data_.gpu.ccMajor = 7;
+  auto gpu2 = Vertex::new_gpu("gpu2");
+  gpu2->data_.gpu.pciDev.addr = {0, 3, 0, 0};
+  g.join(pkg, br, Edge::new_pci(16));
+  g.join(br, gpu, Edge::new_pci(8));
+  g.join(br, gpu2, Edge::new_pci(8));
+  auto node = std::make_shared<Vertex>(Vertex::Type::NumaNode);
+  node->data_.numaNode.idx = 1;
+  node->data_.numaNode.memory = uint64_t(1) << 36;
+  g.join(pkg, node, Edge::new_memory(int64_t(100) << 30));
+  auto core = std::make_shared<Vertex>(Vertex::Type::Core);
+  core->data_.core.idx = 5;
+  core->data_.core.pkgIdx = 1;
+  core->data_.core.locality.add_cpu(5);
+  g.join(pkg, core, Edge::new_onchip());
+  auto nic = std::make_shared<Vertex>(Vertex::Type::Nic);
+  nic->data_.osDev.pciDev.addr = {0, 4, 0, 0};
+  nic->data_.osDev.add_name("ib0");
+  nic->data_.osDev.add_name("mlx5_0");
+  nic->data_.osDev.add_name("ib0");
+  g.join(br, nic, Edge::new_pci(8));
+  auto nvlink = Edge::new_nvlink(2, 4);
+  nvlink->latency_ = 2e-6;
+  g.join(gpu, gpu2, nvlink);
+
+  std::stringstream ss;
+  json::write(ss, g);
+  Graph h = json::read(ss);
+
+  REQUIRE(7 == h.vertices().size());
+  REQUIRE(7 == h.edges().size());
+
+  Vertex_t hgpu = h.get_pci({0, 2, 0, 0});
+  REQUIRE(hgpu);
+  REQUIRE(Vertex::Type::Gpu == hgpu->type_);
+  REQUIRE("gpu" == hgpu->name_);
+  REQUIRE(0x10de == hgpu->data_.gpu.pciDev.vendorId);
+  REQUIRE(15.75f == hgpu->data_.gpu.pciDev.linkSpeed);
+  REQUIRE(7 == hgpu->data_.gpu.ccMajor);
+
+  Vertex_t hnic = h.get_pci({0, 4, 0, 0});
+  REQUIRE(hnic);
+  REQUIRE(Vertex::Type::Nic == hnic->type_);
+  REQUIRE(std::string("ib0,mlx5_0") == hnic->data_.osDev.names);
+
+  Vertex_t hbr = h.get_bridge_for_address({0, 3, 0, 0});
+  REQUIRE(hbr);
+  REQUIRE(1 == hbr->data_.bridge_.secondaryBus.bus_);
+  REQUIRE(3 == hbr->data_.bridge_.subordinateBus.bus_);
+
+  Vertex_t hpkg = *h.vertices<Vertex::Type::Intel>().begin();
+  REQUIRE(std::string("Xeon") == hpkg->data_.intel.model);
+  REQUIRE(0x4f == hpkg->data_.intel.modelNumber);
+  REQUIRE(hpkg->data_.intel.locality.has_cpu(2));
+  REQUIRE(hpkg->data_.intel.locality.has_cpu(67));
+  REQUIRE(!hpkg->data_.intel.locality.has_cpu(3));
+  REQUIRE(1 == hpkg->data_.intel.locality.first_node());
+  REQUIRE(hbr->data_.bridge_.locality.empty());
+
+  Vertex_t hnode = *h.vertices<Vertex::Type::NumaNode>().begin();
+  REQUIRE(1 == hnode->data_.numaNode.idx);
+  REQUIRE((uint64_t(1) << 36) == hnode->data_.numaNode.memory);
+  Path mem = h.shortest_path(hpkg, [](const Vertex_t &v) {
+                return v->type_ == Vertex::Type::NumaNode;
+              }).first;
+  REQUIRE(1 == mem.size());
+  REQUIRE((int64_t(100) << 30) == mem[0]->bandwidth());
+  Vertex_t hcore = *h.vertices<Vertex::Type::Core>().begin();
+  REQUIRE(5 == hcore->data_.core.idx);
+  REQUIRE(1 == hcore->data_.core.pkgIdx);
+  REQUIRE(hcore->data_.core.locality.has_cpu(5));
+
+  Path p = h.widest_path(hpkg, hgpu);
+  REQUIRE(2 == p.size());
+  REQUIRE(8e9 == path_bandwidth(p));
+
+  Path q = h.lowest_latency_path(hgpu, h.get_pci({0, 3, 0, 0}));
+  REQUIRE(2 == q.size()); // 2 PCIe hops beat the slow NVLink
+  Path r = h.min_path<cost::Hops>(hgpu, h.get_pci({0, 3, 0, 0}));
+  REQUIRE(1 == r.size());
+  REQUIRE(2e-6 == r[0]->latency());
+
+  std::stringstream bad("{\"vertices\":[], \"edges\":[{\"u\":0,\"v\":1}]}");
+  REQUIRE_THROWS(json::read(bad));
+}
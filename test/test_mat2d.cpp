@@ -0,0 +1,26 @@
+#include "catch2/catch.hpp"
+
+#include "hwgraph/mat2d.hpp"
+
+TEST_CASE("mat2d", "") {
+
+  SECTION("ctor") {
+    Mat2D<int> m(2, 3, 7);
+    REQUIRE(2 == m.rows());
+    REQUIRE(3 == m.cols());
+    REQUIRE(7 == m(1, 2));
+    REQUIRE(7 == m[1][2]);
+  }
+
+  SECTION("resize") {
+    Mat2D<int> m(2, 2, 0);
+    m(0, 1) = 1;
+    m(1, 0) = 2;
+    m.resize(3, 3);
+    REQUIRE(3 == m.rows());
+    REQUIRE(3 == m.cols());
+    REQUIRE(1 == m(0, 1));
+    REQUIRE(2 == m(1, 0));
+    REQUIRE(0 == m(2, 2));
+  }
+}
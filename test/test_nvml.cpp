@@ -0,0 +1,44 @@
+#include "catch2/catch.hpp"
+
+#include "hwgraph/hwgraph.hpp"
+
+// provided by nvml_stub.cpp
+extern "C" int hwgraph_nvml_stub_inits();
+extern "C" int hwgraph_nvml_stub_shutdowns();
+
+using namespace hwgraph;
+
+TEST_CASE("nvml session", "[nvml]") {
+
+  SECTION("not initialized until used") {
+    REQUIRE(0 == nvml::Session::active());
+    REQUIRE(hwgraph_nvml_stub_inits() == hwgraph_nvml_stub_shutdowns());
+  }
+
+  SECTION("nested sessions share one init") {
+    const int inits = hwgraph_nvml_stub_inits();
+    const int shutdowns = hwgraph_nvml_stub_shutdowns();
+    {
+      nvml::Session a;
+      REQUIRE(1 == nvml::Session::active());
+      {
+        nvml::Session b;
+        REQUIRE(2 == nvml::Session::active());
+      }
+      REQUIRE(inits + 1 == hwgraph_nvml_stub_inits());
+      REQUIRE(shutdowns == hwgraph_nvml_stub_shutdowns());
+    }
+    REQUIRE(0 == nvml::Session::active());
+    REQUIRE(shutdowns + 1 == hwgraph_nvml_stub_shutdowns());
+  }
+
+  SECTION("discovery shuts down when done") {
+    const int inits = hwgraph_nvml_stub_inits();
+    const int shutdowns = hwgraph_nvml_stub_shutdowns();
+    Graph g = make_graph(DiscoveryMethod::Nvml);
+    REQUIRE(g.vertices().empty());
+    REQUIRE(inits + 1 == hwgraph_nvml_stub_inits());
+    REQUIRE(shutdowns + 1 == hwgraph_nvml_stub_shutdowns());
+    REQUIRE(0 == nvml::Session::active());
+  }
+}
@@ -0,0 +1,151 @@
+#include "catch2/catch.hpp"
+
+#include <sstream>
+
+#include "hwgraph/hwgraph.hpp"
+
+using namespace hwgraph;
+
+// NVML answers for the four GPUs in 2socket-4gpu.xml, wired as a ring with
+// doubled links between GPUs that share a package
+static nvml::Recording ring_recording() {
+  const unsigned int buses[4] = {0x02, 0x03, 0x82, 0x83};
+  // peer of each of the six links, or -1 if the link is down
+  const int peers[4][6] = {{1, 1, 2, -1, -1, -1},
+                           {0, 0, 3, -1, -1, -1},
+                           {3, 3, 0, -1, -1, -1},
+                           {2, 2, 1, -1, -1, -1}};
+
+  nvml::Recording r;
+  r.hasCount = true;
+  r.count = 4;
+  for (unsigned int d = 0; d < 4; ++d) {
+    r.pci[d] = {0, buses[d], 0};
+    r.names[d] = "Tesla V100-SXM2-16GB";
+    r.cc[d] = std::make_pair(7, 0);
+    for (unsigned int l = 0; l < 6; ++l) {
+      const nvml::Recording::Link link(d, l);
+      if (peers[d][l] < 0) {
+        r.linkState[link] = nvml::LinkState::Inactive;
+      } else {
+        r.linkState[link] = nvml::LinkState::Active;
+        r.remotePci[link] = {0, buses[peers[d][l]], 0};
+        r.linkVersion[link] = 2;
+      }
+    }
+    // a V100 has six links
+    r.linkState[nvml::Recording::Link(d, 6)] = nvml::LinkState::Unsupported;
+  }
+  return r;
+}
+
+#if HWGRAPH_USE_HWLOC == 1
+TEST_CASE("nvml backend", "[nvml]") {
+
+  const std::string path =
+      std::string(HWGRAPH_TEST_TOPOLOGY_DIR) + "/2socket-4gpu.xml";
+  hwloc::Topology topo = hwloc::Topology::from_xml(path);
+  const DiscoveryMethod methods = DiscoveryMethod::Hwloc | DiscoveryMethod::Nvml;
+
+  SECTION("replay") {
+    nvml::ReplayBackend nvml(ring_recording());
+    Graph g = make_graph(methods, topo, nvml);
+
+    REQUIRE(4 == g.vertices<Vertex::Type::Gpu>().size());
+    Vertex_t g0 = g.get_pci({0, 0x02, 0, 0});
+    Vertex_t g1 = g.get_pci({0, 0x03, 0, 0});
+    Vertex_t g2 = g.get_pci({0, 0x82, 0, 0});
+    REQUIRE(g0);
+    REQUIRE(Vertex::Type::Gpu == g0->type_);
+    REQUIRE("Tesla V100-SXM2-16GB" == g0->name_);
+    REQUIRE(7 == g0->data_.gpu.ccMajor);
+    REQUIRE(0x10de == g0->data_.gpu.pciDev.vendorId);
+
+    // parallel links are merged into one edge per GPU pair
+    int64_t nvlinks = 0;
+    for (const Edge_t &e : g.edges()) {
+      if (e->type_ == Edge::Type::Nvlink) {
+        ++nvlinks;
+        REQUIRE(2 == e->data_.nvlink.version);
+      }
+    }
+    REQUIRE(4 == nvlinks);
+
+    auto lanes = [&](Vertex_t u, Vertex_t v) -> int64_t {
+      for (const Edge_t &e : u->edges_) {
+        if (e->type_ == Edge::Type::Nvlink && e->other_vertex(u) == v) {
+          return e->data_.nvlink.lanes;
+        }
+      }
+      return 0;
+    };
+    REQUIRE(2 == lanes(g0, g1));
+    REQUIRE(1 == lanes(g0, g2));
+  }
+
+  SECTION("twelve links") {
+    // an A100 reports NVML_NVLINK_VERSION_3_1 on each of its twelve links.
+    // Four go to each of its peers on the same package
+    nvml::Recording r = ring_recording();
+    for (unsigned int d = 0; d < 4; ++d) {
+      r.cc[d] = std::make_pair(8, 0);
+      for (unsigned int l = 0; l < 12; ++l) {
+        const nvml::Recording::Link link(d, l);
+        const unsigned int peer = d ^ 1;
+        if (l < 4) {
+          r.linkState[link] = nvml::LinkState::Active;
+          r.remotePci[link] = r.pci[peer];
+          r.linkVersion[link] = 5;
+        } else {
+          r.linkState[link] = nvml::LinkState::Inactive;
+        }
+      }
+      r.linkState[nvml::Recording::Link(d, 12)] =
+          nvml::LinkState::Unsupported;
+    }
+    nvml::ReplayBackend nvml(r);
+    Graph g = make_graph(methods, topo, nvml);
+    Vertex_t g0 = g.get_pci({0, 0x02, 0, 0});
+    Vertex_t g1 = g.get_pci({0, 0x03, 0, 0});
+    Path p = g.widest_path(g0, g1);
+    REQUIRE(1 == p.size());
+    REQUIRE(4 == p[0]->data_.nvlink.lanes);
+    REQUIRE(4 * 25e9 == p[0]->bandwidth());
+  }
+
+  SECTION("record") {
+    nvml::ReplayBackend inner(ring_recording());
+    nvml::RecordingBackend nvml(inner);
+    Graph g = make_graph(methods, topo, nvml);
+
+    std::stringstream ss;
+    nvml.recording().write(ss);
+    nvml::ReplayBackend replay(nvml::Recording::read(ss));
+    Graph h = make_graph(methods, topo, replay);
+
+    REQUIRE(g.vertices().size() == h.vertices().size());
+    REQUIRE(g.edges().size() == h.edges().size());
+    REQUIRE(4 == h.vertices<Vertex::Type::Gpu>().size());
+  }
+
+  SECTION("missing answer") {
+    nvml::Recording r = ring_recording();
+    r.names.erase(2);
+    nvml::ReplayBackend nvml(r);
+    REQUIRE_THROWS(make_graph(methods, topo, nvml));
+  }
+}
+#endif
+
+TEST_CASE("nvml recording", "[nvml]") {
+  std::stringstream ss;
+  ring_recording().write(ss);
+  nvml::Recording r = nvml::Recording::read(ss);
+  REQUIRE(4 == r.count);
+  REQUIRE("Tesla V100-SXM2-16GB" == r.names.at(3));
+  REQUIRE(nvml::LinkState::Inactive == r.linkState.at(std::make_pair(1u, 4u)));
+  REQUIRE(0x82 == r.remotePci.at(std::make_pair(3u, 0u)).bus);
+
+  std::stringstream bad("hwgraph-nvml 1\nlink 0 0 sideways\n");
+  REQUIRE_THROWS(nvml::Recording::read(bad));
+}
@@ -0,0 +1,212 @@
+#include "catch2/catch.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <sstream>
+#include <string>
+
+#include "hwgraph/placement.hpp"
+
+using namespace hwgraph;
+
+TEST_CASE("placement", "") {
+
+  Graph g;
+
+  SECTION("two sockets") {
+    // four PCIe GPUs on each socket, NVLink within a socket, X-Bus between
+    // sockets. Candidates alternate sockets, as picking by index would
+    auto cpu0 = std::make_shared<Vertex>();
+    auto cpu1 = std::make_shared<Vertex>();
+    g.join(cpu0, cpu1, Edge::new_xbus(32000000000));
+    std::vector<Vertex_t> gpus;
+    for (int i = 0; i < 8; ++i) {
+      gpus.push_back(Vertex::new_gpu(("gpu" + std::to_string(i)).c_str()));
+      g.join(i % 2 ? cpu1 : cpu0, gpus.back(), Edge::new_pci(16));
+    }
+    for (int i = 0; i < 8; ++i) {
+      for (int j = i + 2; j < 8; j += 2) {
+        g.join(gpus[i], gpus[j], Edge::new_nvlink(2, 1));
+      }
+    }
+
+    for (Objective obj : {Objective::MinPair, Objective::SumPairs}) {
+      Subset s = best_subset(g, gpus, 4, obj);
+      REQUIRE(4 == s.gpus.size());
+      // all on one socket
+      const size_t first = std::find(gpus.begin(), gpus.end(), s.gpus[0]) -
+                           gpus.begin();
+      for (const Vertex_t &v : s.gpus) {
+        const size_t i = std::find(gpus.begin(), gpus.end(), v) - gpus.begin();
+        REQUIRE(i % 2 == first % 2);
+      }
+    }
+    REQUIRE(25e9 == best_subset(g, gpus, 4).score);
+    REQUIRE(6 * 25e9 == best_subset(g, gpus, 4, Objective::SumPairs).score);
+
+    REQUIRE(std::isinf(best_subset(g, gpus, 1).score));
+    REQUIRE(best_subset(g, gpus, 9).gpus.empty());
+    REQUIRE(-1 == best_subset(g, gpus, 9).score);
+  }
+
+  SECTION("exact") {
+    // compare against every subset on small random matrices
+    uint64_t seed = 7;
+    auto rand = [&]() {
+      seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+      return double(seed >> 58); // 0..63
+    };
+    for (int64_t n = 2; n <= 10; ++n) {
+      Mat2D<double> bw(n, n, 0);
+      for (int64_t i = 0; i < n; ++i) {
+        for (int64_t j = i + 1; j < n; ++j) {
+          bw(i, j) = bw(j, i) = rand();
+        }
+      }
+      for (int64_t k = 1; k <= n; ++k) {
+        for (Objective obj : {Objective::MinPair, Objective::SumPairs}) {
+          double best = -1;
+          for (uint64_t mask = 0; mask < (1ull << n); ++mask) {
+            std::vector<int64_t> set;
+            for (int64_t i = 0; i < n; ++i) {
+              if (mask & (1ull << i)) {
+                set.push_back(i);
+              }
+            }
+            if (int64_t(set.size()) == k) {
+              best = std::max(best, subset_score(bw, set, obj));
+            }
+          }
+          std::vector<int64_t> set = best_subset_indices(bw, k, obj);
+          REQUIRE(k == int64_t(set.size()));
+          REQUIRE(best == subset_score(bw, set, obj));
+        }
+      }
+    }
+  }
+
+  SECTION("greedy") {
+    // 24 candidates in clusters of 6: wide inside a cluster, narrow across
+    const int64_t n = 24;
+    Mat2D<double> bw(n, n, 0);
+    for (int64_t i = 0; i < n; ++i) {
+      for (int64_t j = 0; j < n; ++j) {
+        bw(i, j) = i / 6 == j / 6 ? 100 + i % 3 : 10;
+      }
+    }
+    std::vector<int64_t> set = best_subset_indices(bw, 6, Objective::MinPair);
+    REQUIRE(6 == set.size());
+    REQUIRE(set.front() / 6 == set.back() / 6);
+  }
+  SECTION("map_ranks") {
+    // two GPUs per socket, NVLink within a socket
+    auto cpu0 = std::make_shared<Vertex>(Vertex::Type::Intel);
+    auto cpu1 = std::make_shared<Vertex>(Vertex::Type::Intel);
+    cpu0->data_.intel.idx = 0;
+    cpu1->data_.intel.idx = 1;
+    g.join(cpu0, cpu1, Edge::new_xbus(32000000000));
+    std::vector<Vertex_t> gpus;
+    for (int i = 0; i < 4; ++i) {
+      gpus.push_back(Vertex::new_gpu(("gpu" + std::to_string(i)).c_str()));
+      g.join(i % 2 ? cpu1 : cpu0, gpus.back(), Edge::new_pci(16));
+    }
+    g.join(gpus[0], gpus[2], Edge::new_nvlink(2, 1));
+    g.join(gpus[1], gpus[3], Edge::new_nvlink(2, 1));
+
+    // ranks 0 and 1 talk, and so do 2 and 3
+    Mat2D<double> traffic(4, 4, 0);
+    traffic(0, 1) = traffic(1, 0) = 100e9;
+    traffic(2, 3) = traffic(3, 2) = 50e9;
+    traffic(0, 2) = traffic(2, 0) = 1e9;
+
+    RankMap m = map_ranks(g, traffic, gpus, 2);
+    REQUIRE(4 == m.devices.size());
+    auto socket = [&](const Vertex_t &v) {
+      return (std::find(gpus.begin(), gpus.end(), v) - gpus.begin()) % 2;
+    };
+    REQUIRE(socket(m.devices[0]) == socket(m.devices[1]));
+    REQUIRE(socket(m.devices[2]) == socket(m.devices[3]));
+    REQUIRE(Approx(2 * 100e9 / 25e9 + 2 * 50e9 / 25e9 + 2 * 1e9 / 16e9) ==
+            m.cost);
+
+    // bound to the package of each rank's GPU
+    m.devices = {gpus[0], gpus[2], gpus[1], cpu0};
+    std::stringstream ss;
+    write_rankfile(ss, g, m, "node1");
+    REQUIRE(ss.str() == "# rank 0: gpu0 " + gpus[0]->pci_address()->str() +
+                            "\n"
+                            "rank 0=node1 slot=0:0\n"
+                            "# rank 1: gpu2 " +
+                            gpus[2]->pci_address()->str() +
+                            "\n"
+                            "rank 1=node1 slot=0:1\n"
+                            "# rank 2: gpu1 " +
+                            gpus[1]->pci_address()->str() +
+                            "\n"
+                            "rank 2=node1 slot=1:0\n"
+                            "# rank 3: \n"
+                            "rank 3=node1 slot=0:2\n");
+
+    // too few slots
+    REQUIRE(-1 == map_ranks(g, traffic, {gpus[0]}).cost);
+
+    // with cores, ranks are spread over the cores local to their GPU
+    cpu1->data_.intel.locality.add_cpu(2);
+    cpu1->data_.intel.locality.add_cpu(3);
+    auto l3 = std::make_shared<Vertex>(Vertex::Type::L3);
+    g.join(cpu1, l3, Edge::new_onchip());
+    for (unsigned i = 0; i < 2; ++i) {
+      auto core = std::make_shared<Vertex>(Vertex::Type::Core);
+      core->data_.core.idx = 2 + i;
+      core->data_.core.pkgIdx = i;
+      core->data_.core.locality.add_cpu(2 + i);
+      g.join(l3, core, Edge::new_onchip());
+    }
+    m.devices = {gpus[1], gpus[3], gpus[1]};
+    ss.str("");
+    write_rankfile(ss, g, m, "node1");
+    const std::string s = ss.str();
+    REQUIRE(std::string::npos != s.find("rank 0=node1 slot=1:0\n"));
+    REQUIRE(std::string::npos != s.find("rank 1=node1 slot=1:1\n"));
+    REQUIRE(std::string::npos != s.find("rank 2=node1 slot=1:0\n"));
+  }
+
+  SECTION("qap") {
+    // compare against every assignment of 5 ranks to 6 slots
+    uint64_t seed = 3;
+    auto rand = [&]() {
+      seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+      return double(seed >> 58); // 0..63
+    };
+    Mat2D<double> traffic(5, 5), cost(6, 6);
+    for (int64_t i = 0; i < 6; ++i) {
+      for (int64_t j = 0; j < 6; ++j) {
+        cost(i, j) = i == j ? 0 : 1 + rand();
+        if (i < 5 && j < 5) {
+          traffic(i, j) = rand();
+        }
+      }
+    }
+    std::vector<int64_t> perm = {0, 1, 2, 3, 4, 5};
+    double best = std::numeric_limits<double>::infinity();
+    do {
+      best = std::min(best, mapping_cost(traffic, cost, perm));
+    } while (std::next_permutation(perm.begin(), perm.end()));
+
+    std::vector<int64_t> slot = map_ranks_indices(traffic, cost, 4, 8);
+    REQUIRE(5 == slot.size());
+    REQUIRE(Approx(best) == mapping_cost(traffic, cost, slot));
+    REQUIRE(slot == map_ranks_indices(traffic, cost, 4, 8));
+
+    // no restarts still searches once
+    slot = map_ranks_indices(traffic, cost, 1, 0);
+    REQUIRE(5 == slot.size());
+    std::vector<int64_t> sorted = slot;
+    std::sort(sorted.begin(), sorted.end());
+    REQUIRE(sorted.end() == std::unique(sorted.begin(), sorted.end()));
+
+    REQUIRE(map_ranks_indices(Mat2D<double>(5, 4), cost).empty());
+    REQUIRE(map_ranks_indices(traffic, Mat2D<double>(6, 5)).empty());
+  }
+}
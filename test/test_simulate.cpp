@@ -0,0 +1,131 @@
+#include "catch2/catch.hpp"
+
+#include <cmath>
+
+#include "hwgraph/simulate.hpp"
+
+#include "count_allocs.hpp"
+#include "switch_tree.hpp"
+
+using namespace hwgraph;
+
+TEST_CASE("simulate", "") {
+
+  SwitchTree tree;
+  Graph &g = tree.g;
+  const Vertex_t &cpu = tree.cpu;
+  const Vertex_t &gpu0 = tree.gpu0, &gpu1 = tree.gpu1, &gpu2 = tree.gpu2;
+  const Edge_t &up = tree.up;
+  CsrGraph c = freeze(g);
+
+  auto transfer = [&](const Vertex_t &src, const Vertex_t &dst, double bytes,
+                      double start) {
+    Transfer t;
+    t.src = c.id(src);
+    t.dst = c.id(dst);
+    t.bytes = bytes;
+    t.start = start;
+    return t;
+  };
+
+  SECTION("alone") {
+    SimResult r = simulate(c, {transfer(cpu, gpu0, 16e9, 2)});
+    REQUIRE(2 == r.start[0]);
+    REQUIRE(3 == r.finish[0]);
+    REQUIRE(r.utilization.empty());
+  }
+
+  SECTION("sharing") {
+    // both get 8 GB/s until the smaller finishes, then the other gets 16
+    SimResult r = simulate(
+        c, {transfer(cpu, gpu0, 16e9, 0), transfer(cpu, gpu0, 8e9, 0)});
+    REQUIRE(Approx(1.5) == r.finish[0]);
+    REQUIRE(Approx(1.0) == r.finish[1]);
+  }
+
+  SECTION("dependencies") {
+    std::vector<Transfer> ts = {transfer(cpu, gpu0, 16e9, 0),
+                                transfer(gpu0, gpu1, 10e9, 0),
+                                transfer(cpu, gpu2, 8e9, 3)};
+    ts[1].after = {0};
+    ts[2].after = {0};
+    SimResult r = simulate(c, ts);
+    REQUIRE(1 == r.start[1]);
+    REQUIRE(2 == r.finish[1]);
+    REQUIRE(3 == r.start[2]);
+    REQUIRE(4 == r.finish[2]);
+  }
+
+  SECTION("never") {
+    auto island = std::make_shared<Vertex>();
+    g.insert_vertex(island);
+    CsrGraph c2 = freeze(g);
+    std::vector<Transfer> ts(2);
+    ts[0].src = c2.id(cpu);
+    ts[0].dst = c2.id(island);
+    ts[0].bytes = 1;
+    ts[0].start = 0;
+    ts[1] = ts[0];
+    ts[1].dst = c2.id(gpu0);
+    ts[1].after = {0};
+    SimResult r = simulate(c2, ts);
+    REQUIRE(std::isinf(r.finish[0]));
+    REQUIRE(std::isinf(r.start[1]));
+    REQUIRE(std::isinf(r.finish[1]));
+  }
+
+  SECTION("utilization") {
+    SimResult r =
+        simulate(c, {transfer(cpu, gpu0, 16e9, 0), transfer(cpu, gpu0, 8e9, 0)},
+                 Routing::Widest, true);
+    const bool forward = c.edge_u(c.id(up)) == c.id(cpu);
+    const std::vector<Utilization> &u = r.utilization[c.id(up)];
+
+    // the uplink is full until both are done
+    REQUIRE(2 == u.size());
+    REQUIRE(0 == u[0].time);
+    REQUIRE(16e9 == (forward ? u[0].forward : u[0].backward));
+    REQUIRE(0 == (forward ? u[0].backward : u[0].forward));
+    REQUIRE(Approx(1.5) == u[1].time);
+    REQUIRE(0 == u[1].forward);
+    REQUIRE(0 == u[1].backward);
+  }
+
+  SECTION("reuse") {
+    std::vector<Transfer> ts;
+    for (int i = 0; i < 100; ++i) {
+      ts.push_back(transfer(i % 2 ? gpu0 : gpu2, gpu1, 1e9, i * 0.01));
+      if (i > 0) {
+        ts.back().after = {uint32_t(i - 1)};
+      }
+    }
+    Simulator sim(c);
+    sim.run(ts, Routing::Hops);
+
+    const size_t before = num_allocations();
+    const SimResult &r = sim.run(ts, Routing::Hops);
+    REQUIRE(before == num_allocations());
+    // serialized: 50 at 10 GB/s from gpu0, and 50 at 8 GB/s from gpu2
+    REQUIRE(Approx(50 * 0.1 + 50 * 0.125) == r.finish.back());
+  }
+
+  SECTION("long-lived transfers keep their finish events") {
+    // four transfers to gpu2 outlast a chain of short ones under the switch,
+    // which re-solve rates without changing theirs
+    std::vector<Transfer> ts;
+    for (int i = 0; i < 4; ++i) {
+      ts.push_back(transfer(cpu, gpu2, 100e9, 0));
+    }
+    for (int i = 0; i < 1000; ++i) {
+      ts.push_back(transfer(gpu0, gpu1, 1e6, 0));
+      if (i > 0) {
+        ts.back().after = {uint32_t(ts.size() - 2)};
+      }
+    }
+    Simulator sim(c);
+    const SimResult &r = sim.run(ts);
+    REQUIRE(Approx(50) == r.finish[0]);
+    REQUIRE(Approx(1000 * 1e-4) == r.finish.back());
+    REQUIRE(sim.event_capacity() <= 16);
+  }
+}
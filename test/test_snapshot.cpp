@@ -0,0 +1,104 @@
+#include "catch2/catch.hpp"
+
+#include <cstddef>
+#include <fstream>
+
+#include "hwgraph/snapshot.hpp"
+
+using namespace hwgraph;
+
+TEST_CASE("snapshot", "") {
+
+  const std::string path = "test_snapshot.bin";
+
+  Graph g;
+  auto pkg = std::make_shared<Vertex>(Vertex::Type::Intel);
+  pkg->name_ = "cpu";
+  pkg->data_.intel.familyNumber = 6;
+  auto br = Vertex::new_bridge("bridge", {0, 0, 0, 0}, 0, 1, 2);
+  auto gpu = Vertex::new_gpu("gpu");
+  gpu->data_.gpu.pciDev.addr = {0, 2, 0, 0};
+  gpu->data_.gpu.ccMajor = 7;
+  g.join(pkg, br, Edge::new_pci(16));
+  auto link = Edge::new_pci(8);
+  link->latency_ = 1e-6;
+  g.join(br, gpu, link);
+
+  SnapshotKey key;
+  std::strcpy(key.bootId, "boot");
+  key.fingerprint = 42;
+  write_snapshot(g, path, key);
+
+  Snapshot snap(path);
+  REQUIRE(snap.matches(key));
+  REQUIRE(3 == snap.num_vertices());
+  REQUIRE(2 == snap.num_edges());
+
+  SECTION("stale") {
+    SnapshotKey other = key;
+    other.fingerprint = 43;
+    REQUIRE(!snap.matches(other));
+    std::strcpy(other.bootId, "reboot");
+    other.fingerprint = 42;
+    REQUIRE(!snap.matches(other));
+  }
+
+  SECTION("graph") {
+    Graph h = snap.graph();
+    REQUIRE(3 == h.vertices().size());
+    REQUIRE(2 == h.edges().size());
+
+    Vertex_t gpu2 = h.get_pci({0, 2, 0, 0});
+    REQUIRE(gpu2);
+    REQUIRE(Vertex::Type::Gpu == gpu2->type_);
+    REQUIRE("gpu" == gpu2->name_);
+    REQUIRE(7 == gpu2->data_.gpu.ccMajor);
+    REQUIRE(h.get_bridge_for_address({0, 2, 0, 0}));
+
+    REQUIRE(1 == h.vertices<Vertex::Type::Intel>().size());
+    Vertex_t pkg2 = *h.vertices<Vertex::Type::Intel>().begin();
+    REQUIRE(pkg2 != pkg);
+    REQUIRE(6 == pkg2->data_.intel.familyNumber);
+    REQUIRE(8e9 == path_bandwidth(h.widest_path(pkg2, gpu2)));
+    REQUIRE(1e-6 + PCIE_ROOT_COMPLEX_LATENCY ==
+            path_latency(h.widest_path(pkg2, gpu2)));
+  }
+
+  SECTION("methods") {
+    REQUIRE(0 == snap.methods());
+    write_snapshot(g, path, key, 2);
+    REQUIRE(2 == Snapshot(path).methods());
+  }
+
+  SECTION("bad file") {
+    REQUIRE_THROWS(Snapshot("does-not-exist.bin"));
+  }
+
+  // overwrite part of the first vertex or edge record
+  auto corrupt = [&](uint64_t offset, uint32_t value) {
+    std::fstream f(path, std::ios::in | std::ios::out | std::ios::binary);
+    f.seekp(offset);
+    f.write(reinterpret_cast<const char *>(&value), sizeof(value));
+  };
+  const uint64_t vrec = snap.header().vertexOffset;
+  const uint64_t erec = snap.header().edgeOffset;
+
+  SECTION("bad name") {
+    corrupt(vrec + offsetof(SnapshotVertex, nameLength), 1000);
+    Snapshot bad(path);
+    REQUIRE_THROWS_AS(bad.name(0), std::runtime_error);
+    REQUIRE_THROWS_AS(bad.graph(), std::runtime_error);
+  }
+
+  SECTION("bad vertex type") {
+    corrupt(vrec + offsetof(SnapshotVertex, type), 99);
+    REQUIRE_THROWS_AS(Snapshot(path).graph(), std::runtime_error);
+  }
+
+  SECTION("bad edge type") {
+    corrupt(erec + offsetof(SnapshotEdge, type), 99);
+    REQUIRE_THROWS_AS(Snapshot(path).graph(), std::runtime_error);
+  }
+
+  std::remove(path.c_str());
+}